@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "commands.h"
+#include "utils/headers/options.h"
+
+// Scaling sweep of the indexes of demo, the reference for performance work.
+// For every dataset size it generates a synthetic layer, builds each index
+// (the sharded ones with every thread count) and runs the same generated
+// queries at every selectivity and thread count, appending all the builds and
+// query runs to one report that `bench-diff` compares.
+//
+// The sweep is a list of demo commands run in script mode, so it measures
+// exactly what the CLI runs; --dry-run prints them.
+
+namespace {
+
+	std::vector<std::string> splitList(const std::string& text){
+
+		std::vector<std::string> items;
+		std::istringstream iss(text);
+		for(std::string item; std::getline(iss, item, ','); ){
+			if(!item.empty()){
+				items.push_back(item);
+			}
+		}
+		return items;
+	}
+
+	// checks that every item is a number, keeping the text so that 1e6 reaches demo as written
+	std::vector<std::string> numberList(const std::string& name, const std::string& text){
+
+		const std::vector<std::string> items = splitList(text);
+		if(items.empty()){
+			throw std::invalid_argument("--" + name + " needs at least one value");
+		}
+		for(const std::string& item : items){
+			if(spatial::parseValue<double>("--" + name, item) <= 0){
+				throw std::invalid_argument("--" + name + " values must be positive");
+			}
+		}
+		return items;
+	}
+
+	bool sharded(const std::string& type){
+		return type == "quad-tree" || type == "r-tree";
+	}
+}
+
+int main(int argc, char* argv[]){
+
+	const std::vector<std::string> args(argv + 1, argv + argc);
+	const std::string maxThreads = std::to_string(std::max(1u, std::thread::hardware_concurrency()));
+
+	try{
+		const spatial::Options options(args, {"sizes", "kind", "layout", "indexes", "selectivities", "threads", "queries", "repeat", "seed", "report"}, {"dry-run", "verify", "help"});
+
+		if(options.has("help") || !options.positional().empty()){
+			std::cerr<<"usage: spatial_bench [--sizes 1e3,1e4,1e5,1e6] [--kind points|lines|polygons] [--layout uniform|clusters|roads|overlapping]"<<std::endl
+			<<"                     [--indexes type,type] [--selectivities 0.0001,0.001,0.01] [--threads 1,"<<maxThreads<<"]"<<std::endl
+			<<"                     [--queries N] [--repeat N] [--seed S] [--report file.json|file.csv] [--verify] [--dry-run]"<<std::endl;
+			return 2;
+		}
+
+		const std::string kind = options.get<std::string>("kind", "points");
+		const std::string layout = options.get<std::string>("layout", kind == "points" ? "uniform" : "overlapping");
+		const std::vector<std::string> sizes = numberList("sizes", options.get<std::string>("sizes", "1e3,1e4,1e5,1e6"));
+		const std::vector<std::string> selectivities = numberList("selectivities", options.get<std::string>("selectivities", "0.0001,0.001,0.01"));
+		const std::vector<std::string> threads = numberList("threads", options.get<std::string>("threads", maxThreads == "1" ? "1" : "1," + maxThreads));
+		const std::size_t queries = options.get<std::size_t>("queries", 1000);
+		const std::size_t repeat = options.get<std::size_t>("repeat", 3);
+		const std::string seed = std::to_string(options.get<std::uint64_t>("seed", 42));
+		const std::string report = options.get<std::string>("report", "spatial_bench.json");
+
+		// the kd-tree only takes points; geohash too, and it is left out unless
+		// asked for as it needs the layer in degrees
+		const std::vector<std::string> indexes = splitList(options.get<std::string>("indexes",
+			kind == "points" ? "kd-tree,quad-tree,r-tree,aggregate-r-tree" : "quad-tree,r-tree,aggregate-r-tree"));
+		std::string indexList;
+		bool geohash = false;
+		for(const std::string& type : indexes){
+			indexList += (indexList.empty() ? "" : ",") + type;
+			geohash = geohash || type == "geohash";
+		}
+
+		// geohash reads the coordinates as longitude and latitude: on the
+		// default extent every point would clamp to the same cell
+		const std::string extent = geohash ? " --extent 90" : "";
+
+		std::vector<std::string> commands;
+
+		for(const std::string& size : sizes){
+
+			commands.push_back("generate " + kind + " " + size + " --layout " + layout + " --seed " + seed + " --as bench --threads " + maxThreads + extent);
+
+			for(const std::string& type : indexes){
+				for(const std::string& buildThreads : threads){
+					commands.push_back("build " + type + " --dataset bench --threads " + buildThreads + " --report " + report);
+					if(!sharded(type)){
+						break;
+					}
+				}
+			}
+
+			// every compare also runs the queries serially
+			for(const std::string& selectivity : selectivities){
+				for(const std::string& queryThreads : threads){
+					if(queryThreads == "1" && threads.size() > 1){
+						continue;
+					}
+					commands.push_back("compare " + std::to_string(queries) + " --dataset bench --indexes " + indexList + " --selectivity " + selectivity
+						+ " --seed " + seed + " --threads " + queryThreads + " --repeat " + std::to_string(repeat) + " --report " + report
+						+ (options.has("verify") ? " --verify" : ""));
+				}
+			}
+		}
+
+		if(options.has("dry-run")){
+			for(const std::string& command : commands){
+				std::cout<<command<<std::endl;
+			}
+			return 0;
+		}
+
+		// one report per sweep
+		if(!std::ofstream(report, std::ios::trunc)){
+			std::cerr<<"Error: cannot write '"<<report<<"'"<<std::endl;
+			return 1;
+		}
+
+		const int status = run_commands(create_menu(), commands);
+		std::cout<<(status == 0 ? "report: " : "Error: the sweep stopped, partial report: ")<<report<<std::endl;
+		return status;
+
+	}catch(const std::exception& e){
+		std::cerr<<"Error: "<<e.what()<<std::endl;
+		return 2;
+	}
+}
@@ -0,0 +1,3485 @@
+#include <geom/Coordinate.h>
+#include <geom/Envelope.h>
+#include <geos/geom/Point.h>
+#include <geos/geom/GeometryFactory.h>
+#include <geos/index/kdtree/KdTree.h>
+#include <geos/index/quadtree/Quadtree.h>
+#include <geos/index/strtree/STRtree.h>
+#include <geos/index/ItemVisitor.h>
+#include <geos/index/kdtree/KdNodeVisitor.h>
+#include <geos/io/WKTReader.h>
+#include <cli/cli.h>
+#include <index/kdtree/KdNode.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <limits>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <sstream>
+#include <streambuf>
+#include <string_view>
+#include <csignal>
+#include <set>
+#include <cmath>
+#include <thread>
+#include "commands.h"
+#include "utils/headers/shpreader.h"
+#include "utils/headers/geohash.h"
+#include "utils/headers/envelopetable.h"
+#include "utils/headers/threadpool.h"
+#include "utils/headers/shardedindex.h"
+#include "utils/headers/dataset.h"
+#include "utils/headers/hilbert.h"
+#include "utils/headers/predicate.h"
+#include "utils/headers/preparedcache.h"
+#include "utils/headers/pointlocator.h"
+#include "utils/headers/options.h"
+#include "utils/headers/spatialjoin.h"
+#include "utils/headers/server.h"
+#include "utils/headers/aggregatetree.h"
+#include "utils/headers/workload.h"
+#include "utils/headers/histogram.h"
+#include "utils/headers/perfcounters.h"
+#include "utils/headers/phasetimer.h"
+#include "utils/headers/benchreport.h"
+#include "utils/headers/generator.h"
+#include "utils/headers/indexstats.h"
+#include "utils/headers/resultcache.h"
+
+const std::size_t geohashPrecision = 9;
+const std::size_t preparedCacheCapacity = 4096;
+const std::uint64_t defaultSeed = 42;
+
+// result cache of the datasets, set by `cache`; disabled with a budget of 0,
+// a resolution of 0 is relative to the extent of each dataset
+std::atomic<std::size_t> resultCacheBudget = 0;
+std::atomic<double> resultCacheResolution = 0;
+
+std::vector<std::pair<double, double>> envelopeSize{
+    {0.0066733087850, 0.004275088},
+    {0.0204370081538, 0.010114234},
+    {0.0306555122308, 0.01167829}
+};
+
+// every random choice of the commands comes from here, so a session can be
+// replayed with the `seed` command
+std::mt19937_64 randomEngine{defaultSeed};
+
+// candidates reported by the indexes to the searches of this thread, read by
+// compare to show how many of them the refinement throws away
+thread_local std::size_t searchCandidates = 0;
+
+spatial::DatasetRegistry datasets;
+
+std::mutex backgroundTasksMutex;
+std::vector<std::future<std::string>> backgroundTasks;
+
+std::atomic<spatial::QueryServer*> runningServer = nullptr;
+
+void cmd_view(std::ostream& out, const std::string& shapefilePath);
+void cmd_load(std::ostream& out, const std::string& inputFile, const std::string& name = "default");
+void cmd_load(std::ostream& out, const std::vector<std::string>& args);
+void cmd_datasets(std::ostream& out);
+void cmd_stats(std::ostream& out, const std::vector<std::string>& args);
+void cmd_cache(std::ostream& out, const std::vector<std::string>& args);
+void cmd_generate(std::ostream& out, const std::vector<std::string>& args);
+void cmd_wait(std::ostream& out);
+void cmd_build(std::ostream& out, const std::string& type, const std::size_t threads = 1, const std::string& datasetName = "", const bool background = false, spatial::ReportWriter* report = nullptr, const std::string& name = "", const spatial::IndexParams& params = {});
+void cmd_build(std::ostream& out, const std::vector<std::string>& args);
+void cmd_search_range_xy(std::ostream& out, const std::string& type, const double x1, const double y1, const double x2, const double y2, const spatial::Predicate predicate = spatial::Predicate::bbox, const std::string& datasetName = "", const std::size_t limit = 0, const bool exists = false);
+void cmd_search_range_random(std::ostream& out, const std::string& type, const spatial::Predicate predicate = spatial::Predicate::bbox, const std::string& datasetName = "", const std::size_t limit = 0, const bool exists = false);
+void cmd_search_range(std::ostream& out, const std::vector<std::string>& args);
+void cmd_compare_xy(std::ostream& out, const double x1, const double y1, const double x2, const double y2, const std::string& datasetName = "");
+void cmd_compare_random(std::ostream& out, const std::size_t iterations, const std::size_t threads = 1, const spatial::Predicate predicate = spatial::Predicate::bbox, const std::string& datasetName = "");
+void cmd_compare(std::ostream& out, const std::vector<std::string>& args);
+void cmd_search_batch(std::ostream& out, const std::vector<std::string>& args);
+void cmd_count_range(std::ostream& out, const std::vector<std::string>& args);
+void cmd_compare_count(std::ostream& out, const std::size_t iterations, const std::string& datasetName, spatial::WorkloadSpec spec);
+void cmd_workload(std::ostream& out, const std::vector<std::string>& args);
+void cmd_seed(std::ostream& out, const std::uint64_t seed);
+void cmd_bench_diff(std::ostream& out, const std::vector<std::string>& args);
+void cmd_search_polygon(std::ostream& out, const std::vector<std::string>& args);
+void cmd_locate(std::ostream& out, const std::vector<std::string>& args);
+void cmd_join(std::ostream& out, const std::vector<std::string>& args);
+void cmd_knn(std::ostream& out, const std::vector<std::string>& args);
+void cmd_serve(std::ostream& out, const std::vector<std::string>& args);
+bool readShapeFile(const std::string& fileName, std::vector<std::shared_ptr<geos::geom::Geometry>>& geometries, spatial::AttributeTable* attributes = nullptr);
+bool readEnvelopes(const std::string& fileName, std::vector<geos::geom::Envelope>& envelopes);
+bool readPoints(const std::string& fileName, std::vector<geos::geom::CoordinateXY>& points);
+
+std::unique_ptr<cli::Menu> create_menu(){
+
+	auto rootMenu = std::make_unique<cli::Menu>("cli");
+    
+	rootMenu->Insert(
+        "view",
+		{"input"},
+        [](std::ostream& out, const std::string& shapefilePath){
+            cmd_view(out, shapefilePath);
+        },
+        "--input [file.shp]"
+        );
+
+    rootMenu->Insert(
+        "load",
+		{"input"},
+        [](std::ostream& out, const std::string& inputFile){
+            cmd_load(out, inputFile);
+        },
+        "--input [file.shp]"
+        );
+
+    rootMenu->Insert(
+        "load",
+        {"input", "options"},
+        [](std::ostream& out, std::vector<std::string> args){
+            cmd_load(out, args);
+        },
+        "--input [file.shp] [--as name] [--threads N] [--background]"
+        );
+
+    rootMenu->Insert(
+        "generate",
+        {"kind", "count", "options"},
+        [](std::ostream& out, std::vector<std::string> args){
+            cmd_generate(out, args);
+        },
+        "--kind [points|lines|polygons] --count [--layout uniform|clusters|roads|overlapping] [--seed S] [--extent E] [--clusters N] [--spread F] [--size F] [--skew S] [--overlap N] [--as name] [--threads N]"
+        );
+
+    rootMenu->Insert(
+        "datasets",
+        [](std::ostream& out){
+            cmd_datasets(out);
+        },
+        "Lists the loaded datasets and their indexes"
+        );
+
+    rootMenu->Insert(
+        "stats",
+        [](std::ostream& out){
+            cmd_stats(out, {});
+        },
+        "Memory and shape of the indexes of the active dataset"
+        );
+
+    rootMenu->Insert(
+        "stats",
+        {"options"},
+        [](std::ostream& out, std::vector<std::string> args){
+            cmd_stats(out, args);
+        },
+        "[--dataset name]"
+        );
+
+    rootMenu->Insert(
+        "cache",
+        {"budget", "options"},
+        [](std::ostream& out, std::vector<std::string> args){
+            cmd_cache(out, args);
+        },
+        "--budget [MiB|off|clear] [--resolution R]"
+        );
+
+    rootMenu->Insert(
+        "wait",
+        [](std::ostream& out){
+            cmd_wait(out);
+        },
+        "Waits for the background loads and builds"
+        );
+
+    rootMenu->Insert(
+        "build",
+		{"type"},
+        [](std::ostream& out, const std::string& type){
+            cmd_build(out, type);
+        },
+        "--type [kd-tree|quad-tree|r-tree|geohash|aggregate-r-tree]"
+        );
+
+    rootMenu->Insert(
+        "build",
+        {"type", "options"},
+        [](std::ostream& out, std::vector<std::string> args){
+            cmd_build(out, args);
+        },
+        "--type [kd-tree|quad-tree|r-tree|geohash|aggregate-r-tree] [--as name] [--node-capacity N] [--threads N] [--dataset name] [--background | --report file.json|file.csv]"
+        );
+
+	rootMenu->Insert(
+        "search_range",
+		{"type", "envelope"},
+        [](std::ostream& out, const std::string& type, const double x1, const double y1, const double x2, const double y2){
+            cmd_search_range_xy(out, type, x1, y1, x2, y2);
+        },
+        "--type [kd-tree|quad-tree|r-tree|geohash|linear] --x1 --y1 --x2 --y2"
+        );
+    
+	rootMenu->Insert(
+        "search_range",
+		{"type"},
+        [](std::ostream& out, const std::string& type){
+            cmd_search_range_random(out, type);
+        },
+        "--type [kd-tree|quad-tree|r-tree|geohash|linear]"
+        );
+
+    rootMenu->Insert(
+        "search_range",
+        {"type", "options"},
+        [](std::ostream& out, std::vector<std::string> args){
+            cmd_search_range(out, args);
+        },
+        "--type [kd-tree|quad-tree|r-tree|geohash|linear] [--x1 --y1 --x2 --y2] [--predicate bbox|intersects|contains|within] [--limit N | --exists] [--dataset name]"
+        );
+
+    rootMenu->Insert(
+        "count_range",
+        {"type", "options"},
+        [](std::ostream& out, std::vector<std::string> args){
+            cmd_count_range(out, args);
+        },
+        "--type [aggregate-r-tree|kd-tree|quad-tree|r-tree|geohash|linear] [--x1 --y1 --x2 --y2] [--sum field,field] [--dataset name]"
+        );
+
+    rootMenu->Insert(
+        "search_polygon",
+        {"type", "options"},
+        [](std::ostream& out, std::vector<std::string> args){
+            cmd_search_polygon(out, args);
+        },
+        "--type [kd-tree|quad-tree|r-tree|geohash|linear] [--wkt \"POLYGON(...)\" | --file file.wkt] [--predicate intersects|within] [--dataset name]"
+        );
+
+    rootMenu->Insert(
+        "locate",
+        {"points", "options"},
+        [](std::ostream& out, std::vector<std::string> args){
+            cmd_locate(out, args);
+        },
+        "--points [file.shp|file.txt] [--threads N] [--output file] [--dataset name]"
+        );
+
+    rootMenu->Insert(
+        "join",
+        {"file", "options"},
+        [](std::ostream& out, std::vector<std::string> args){
+            cmd_join(out, args);
+        },
+        "--file [file.shp|dataset] [--predicate bbox|intersects|contains|within] [--threads N] [--grid N] [--dataset name]"
+        );
+
+    rootMenu->Insert(
+        "knn",
+        {"type", "options"},
+        [](std::ostream& out, std::vector<std::string> args){
+            cmd_knn(out, args);
+        },
+        "--type [kd-tree|quad-tree|r-tree|geohash|linear] --x --y --k [--dataset name]"
+        );
+
+    rootMenu->Insert(
+        "serve",
+        {"options"},
+        [](std::ostream& out, std::vector<std::string> args){
+            cmd_serve(out, args);
+        },
+        "[--unix path | --port N] [--threads N]"
+        );
+
+    rootMenu->Insert(
+        "search_batch",
+        {"type", "options"},
+        [](std::ostream& out, std::vector<std::string> args){
+            cmd_search_batch(out, args);
+        },
+        "--type [kd-tree|quad-tree|r-tree|geohash|linear] [file] [--random N] [--threads N] [--predicate P] [--output file] [--dataset name]"
+        );
+	
+	rootMenu->Insert(
+        "compare",
+		{"iterations"},
+        [](std::ostream& out, const std::size_t iterations){
+            cmd_compare_random(out, iterations);
+        },
+        "--iterations"
+    );
+
+    rootMenu->Insert(
+        "compare",
+        {"envelope"},
+        [](std::ostream& out, const double x1, const double y1, const double x2, const double y2){
+            cmd_compare_xy(out, x1, y1, x2, y2);
+        },
+        "--x1 --y1 --x2 --y2"
+        );
+
+    rootMenu->Insert(
+        "compare",
+        {"iterations", "options"},
+        [](std::ostream& out, std::vector<std::string> args){
+            cmd_compare(out, args);
+        },
+        "--iterations [--threads N] [--predicate bbox|intersects|contains|within] [--count] [--seed S] [--distribution uniform|data|zipf] [--selectivity F] [--mix box=N,point=N,radius=N,knn=N] [--save file] [--histogram file] [--breakdown] [--counters] [--verify] [--repeat N] [--report file.json|file.csv] [--indexes type,type] [--dataset name] | --workload file | --x1 --y1 --x2 --y2 --dataset name"
+        );
+
+    rootMenu->Insert(
+        "workload",
+        {"count", "options"},
+        [](std::ostream& out, std::vector<std::string> args){
+            cmd_workload(out, args);
+        },
+        "--count --output file [--seed S] [--distribution uniform|data|zipf] [--selectivity F] [--mix box=N,point=N,radius=N,knn=N] [--hotspots N] [--zipf S] [--k K] [--dataset name]"
+        );
+
+    rootMenu->Insert(
+        "seed",
+		{"seed"},
+        [](std::ostream& out, const std::uint64_t seed){
+            cmd_seed(out, seed);
+        },
+        "--seed: seeds the random envelopes of search_range, count_range and search_batch"
+        );
+
+    rootMenu->Insert(
+        "bench-diff",
+		{"baseline", "current", "options"},
+        [](std::ostream& out, std::vector<std::string> args){
+            cmd_bench_diff(out, args);
+        },
+        "baseline current [--threshold percent]: compares two reports of compare/build --report and flags the regressions"
+        );
+
+	return rootMenu;
+}
+
+std::vector<std::string> split_commands(const std::string& text){
+
+	std::vector<std::string> commands;
+	std::string command;
+	bool quoted = false;
+
+	auto push = [&commands, &command](){
+		const std::size_t first = command.find_first_not_of(" \t\r");
+		if(first != std::string::npos){
+			commands.push_back(command.substr(first, command.find_last_not_of(" \t\r") - first + 1));
+		}
+		command.clear();
+	};
+
+	for(const char c : text){
+		if(c == '"'){
+			quoted = !quoted;
+		}else if(!quoted && c == '#'){
+			break;
+		}else if(!quoted && (c == ';' || c == '\n')){
+			push();
+			continue;
+		}
+		command += c;
+	}
+	push();
+
+	return commands;
+}
+
+// Forwards to another stream buffer and remembers whether any line written
+// through it starts with "Error", which is how the commands report failures.
+class ErrorTrackingBuffer : public std::streambuf{
+public:
+	explicit ErrorTrackingBuffer(std::streambuf* target) : target(target) {}
+
+	bool failed() const{
+		return errorSeen;
+	}
+
+	void reset(){
+		errorSeen = false;
+	}
+
+protected:
+	int overflow(int c) override{
+
+		if(c == traits_type::eof()){
+			return traits_type::not_eof(c);
+		}
+
+		if(lineStart.size() < prefix.size()){
+			lineStart += static_cast<char>(c);
+			if(lineStart == prefix){
+				errorSeen = true;
+			}
+		}
+		if(c == '\n'){
+			lineStart.clear();
+		}
+
+		return target->sputc(static_cast<char>(c));
+	}
+
+	int sync() override{
+		return target->pubsync();
+	}
+
+private:
+	static constexpr std::string_view prefix = "Error";
+
+	std::streambuf* target;
+	std::string lineStart;
+	bool errorSeen = false;
+};
+
+int run_commands(std::unique_ptr<cli::Menu> rootMenu, const std::vector<std::string>& commands){
+
+	ErrorTrackingBuffer buffer(std::cout.rdbuf());
+	std::ostream out(&buffer);
+
+	cli::Cli cli(std::move(rootMenu));
+	cli.StdExceptionHandler(
+		[](std::ostream& out, const std::string& cmd, const std::exception& e){
+			out << "Error: " << e.what() << " handling command: " << cmd << ".\n";
+		}
+		);
+	cli.WrongCommandHandler(
+		[](std::ostream& out, const std::string& cmd){
+			out << "Error: unknown command or wrong parameters: " << cmd << ".\n";
+		}
+		);
+
+	cli::CliSession session(cli, out);
+	int status = 0;
+
+	for(const std::string& command : commands){
+
+		if(command == "exit" || command == "quit"){
+			break;
+		}
+
+		out<<"> "<<command<<std::endl;
+		session.Feed(command);
+
+		if(buffer.failed()){
+			status = 1;
+			break;
+		}
+	}
+
+	buffer.reset();
+	cmd_wait(out);
+	out.flush();
+
+	return (status != 0 || buffer.failed()) ? 1 : 0;
+}
+
+std::string time_to_string(const double time){
+	std::ostringstream oss;
+	if(time < 1000){
+		oss<<time<<" milliseconds";
+	}else{
+		oss<<time/1000.0<<" seconds";
+	}
+	return oss.str();
+}
+
+std::string bytes_to_string(const double bytes){
+	std::ostringstream oss;
+	if(bytes < 1024){
+		oss<<bytes<<" bytes";
+	}else if(bytes < 1024 * 1024){
+		oss<<bytes/1024<<" KiB";
+	}else{
+		oss<<bytes/(1024 * 1024)<<" MiB";
+	}
+	return oss.str();
+}
+
+int randInt(const int a, const int b){
+		std::uniform_int_distribution<int> dist(a, b);
+		return dist(randomEngine);
+}
+
+double randDouble(const double a, const double b){
+		std::uniform_real_distribution<double> dist(a, b);
+		return dist(randomEngine);
+}
+
+bool isValidType(const std::string& type){
+    return (type == "kd-tree" ||type == "quad-tree" || type == "r-tree" || type == "geohash" || type == "aggregate-r-tree" || type == "linear");
+}
+
+// A type, or the name an index of the dataset was built under.
+bool isValidIndex(const spatial::Dataset& dataset, const std::string& index){
+    return isValidType(index) || dataset.indexes.find(index) != nullptr;
+}
+
+geos::geom::Envelope create_random_envelope(const double x1, const double y1, const double x2, const double y2, const double width, const double height){
+	
+	double random_x = randDouble(x1, x2); 
+	double random_y = randDouble(y1, y2);
+
+	return geos::geom::Envelope(random_x, random_x + width, random_y, random_y + height);
+}
+
+// Box queries only, with the fixed sizes, unless the spec says otherwise.
+spatial::WorkloadSpec default_workload_spec(const std::uint64_t seed){
+
+	spatial::WorkloadSpec spec;
+	spec.seed = seed;
+	spec.sizes = envelopeSize;
+	return spec;
+}
+
+std::vector<spatial::Query> create_workload(const spatial::Dataset& dataset, const spatial::WorkloadSpec& spec, const std::size_t count){
+
+	spatial::WorkloadGenerator generator(spec, dataset.envelopes(), geos::geom::Envelope(dataset.minX, dataset.maxX, dataset.minY, dataset.maxY));
+	return generator.generate(count);
+}
+
+std::vector<geos::geom::Envelope> create_random_envelopes(const spatial::Dataset& dataset, const std::size_t count){
+
+	std::vector<geos::geom::Envelope> envelopes;
+	envelopes.reserve(count);
+
+	for(const spatial::Query& query : create_workload(dataset, default_workload_spec(randomEngine()), count)){
+		envelopes.push_back(query.box);
+	}
+
+	return envelopes;
+}
+
+void cmd_view(std::ostream& out, const std::string& shapefilePath){
+
+	std::string command = "qgis \"" + shapefilePath + "\" 2>/dev/null";
+    int result = system(command.c_str());
+    
+    if (result != 0) {
+        out<<"Failed to open QGIS with shapefile: "<<shapefilePath<<std::endl;
+    }
+}
+
+// The dataset with that name, or the last one loaded when the name is empty.
+std::shared_ptr<spatial::Dataset> find_dataset(std::ostream& out, const std::string& name){
+
+	std::shared_ptr<spatial::Dataset> dataset = datasets.get(name);
+
+	if(!dataset){
+		if(name.empty()){
+			out<<"Error: no geometries loaded"<<std::endl;
+		}else{
+			out<<"Error: no dataset named '"<<name<<"'"<<std::endl;
+		}
+	}
+
+	return dataset;
+}
+
+// Builds the index aside and publishes it under the name only once complete:
+// until then the queries keep using the previous index of that name, if any.
+bool build(spatial::Dataset& dataset, const std::string& name, const std::string& type, const spatial::IndexParams& params, const std::size_t threads, spatial::BuildStats& stats){
+
+	const std::shared_ptr<spatial::IndexSlot> slot = dataset.indexes.slotFor(name, type, params);
+
+	// what the new index holds, taken before it replaces the previous one
+	const std::uint64_t heapBefore = spatial::heapInUse();
+	auto recordHeapGrowth = [&dataset, &name, heapBefore](){
+		const std::uint64_t heapAfter = spatial::heapInUse();
+		dataset.indexes.recordHeapGrowth(name, heapAfter > heapBefore ? heapAfter - heapBefore : 0);
+	};
+
+	if(type == "kd-tree"){
+	
+		auto kdTree = std::make_shared<geos::index::kdtree::KdTree>(std::numeric_limits<double>::epsilon());
+		spatial::ScopedPhase phase(spatial::Phase::insert);
+
+		for(size_t i=0; i<dataset.geometries.size(); i++){
+			
+			if(dataset.geometries[i]->getGeometryTypeId() != geos::geom::GEOS_POINT){
+				return false; 
+			}
+			geos::geom::Coordinate coord(*std::static_pointer_cast<geos::geom::Point>(dataset.geometries[i])->getCoordinate());
+			kdTree->insert(coord, reinterpret_cast<void*>(i));
+		}
+
+		recordHeapGrowth();
+		slot->kdTree.store(std::move(kdTree));
+
+	}else if(type == "quad-tree"){
+		
+		spatial::ThreadPool pool(threads);
+
+		auto quadTree = std::make_shared<spatial::ShardedIndex<geos::index::quadtree::Quadtree>>();
+		stats = quadTree->build(dataset.envelopes(), pool);
+
+		recordHeapGrowth();
+		slot->quadTree.store(std::move(quadTree));
+
+	}else if(type == "r-tree"){
+	
+		spatial::ThreadPool pool(threads);
+
+		// the shards are STRtrees, which build themselves on the first query;
+		// ShardedIndex builds them upfront so concurrent queries do not race
+		auto rTree = std::make_shared<spatial::ShardedIndex<geos::index::strtree::STRtree>>([nodeCapacity = params.nodeCapacity]{
+			return std::make_unique<geos::index::strtree::STRtree>(nodeCapacity);
+		});
+		stats = rTree->build(dataset.envelopes(), pool);
+
+		recordHeapGrowth();
+		slot->rTree.store(std::move(rTree));
+
+	}else if(type == "geohash"){
+		
+		auto geohash = std::make_shared<spatial::GeohashIndex>();
+
+		{
+			spatial::ScopedPhase phase(spatial::Phase::insert);
+
+			for(size_t i=0; i<dataset.geometries.size(); i++){
+				
+				if(dataset.geometries[i]->getGeometryTypeId() != geos::geom::GEOS_POINT){
+					return false; 
+				}
+				geos::geom::Coordinate coord(*std::static_pointer_cast<geos::geom::Point>(dataset.geometries[i])->getCoordinate());
+				geohash->push_back({GeoHash::encode(coord.y, coord.x, geohashPrecision), i});
+			}
+		}
+
+		{
+			spatial::ScopedPhase phase(spatial::Phase::sort);
+			std::sort(geohash->begin(), geohash->end());
+		}
+
+		recordHeapGrowth();
+		slot->geohash.store(std::move(geohash));
+
+	}else if(type == "aggregate-r-tree"){
+
+		auto aggregateRTree = std::make_shared<spatial::AggregateRTree>();
+		{
+			spatial::ScopedPhase phase(spatial::Phase::insert);
+			aggregateRTree->build(dataset.envelopes(), dataset.attributes);
+		}
+
+		recordHeapGrowth();
+		slot->aggregateRTree.store(std::move(aggregateRTree));
+	}
+
+	if(type != "linear"){
+		dataset.indexes.publish(name, slot);
+	}
+	dataset.resultCache.invalidate(name);
+
+	return true;
+}
+
+// Prints the time spent in each phase between two readings of the phase
+// totals, against the total time measured around them.
+void phase_breakdown(std::ostream& out, const spatial::PhaseTotals& before, const spatial::PhaseTotals& after, const double totalTime, const std::size_t operations){
+
+	const double ticksPerMillisecond = spatial::ticksPerNanosecond() * 1e6;
+	double timed = 0;
+
+	out<<"phases:"<<std::endl;
+	for(std::size_t p = 0; p < spatial::PHASES; p++){
+
+		const std::uint64_t calls = after.calls[p] - before.calls[p];
+		if(calls == 0){
+			continue;
+		}
+
+		const double time = (after.ticks[p] - before.ticks[p]) / ticksPerMillisecond;
+		timed += time;
+
+		out<<"  "<<spatial::phaseName(static_cast<spatial::Phase>(p))<<": "<<time_to_string(time / operations)
+		<<" ("<<(totalTime > 0 ? time / totalTime * 100 : 0)<<"%), "<<static_cast<double>(calls) / operations<<" scopes"<<std::endl;
+	}
+	out<<"  untimed: "<<time_to_string(std::max(0.0, totalTime - timed) / operations)<<std::endl;
+}
+
+// Builds the index and prints the times; record, when given, receives the
+// numbers for a benchmark report.
+bool build_report(std::ostream& out, spatial::Dataset& dataset, const std::string& name, const std::string& type, const spatial::IndexParams& params, const std::size_t threads, spatial::BenchRecord* record = nullptr){
+
+	spatial::BuildStats stats;
+	const spatial::PhaseTotals phasesBefore = spatial::threadPhaseTotals();
+	const std::uint64_t residentBefore = spatial::residentBytes();
+	spatial::resetPeakResident();
+
+	std::chrono::duration<double, std::milli> duration;
+	const auto start = std::chrono::steady_clock::now();
+
+	try{
+		if(!build(dataset, name, type, params, threads, stats)){
+			out<<"Error building the data structure"<<std::endl;
+			return false;
+		}
+	}catch(const std::invalid_argument& e){
+		// another build took the name meanwhile
+		out<<"Error: "<<e.what()<<std::endl;
+		return false;
+	}
+
+	const auto end = std::chrono::steady_clock::now();
+	duration = end - start;
+
+	out<<name<<" built successfully"<<std::endl
+	<<"time: "<<time_to_string(duration.count())<<std::endl
+	<<"geometries: "<<dataset.geometries.size()<<std::endl;
+
+	if(name != type){
+		out<<"type: "<<type<<std::endl;
+	}
+	if(type == "r-tree"){
+		out<<"node capacity: "<<params.nodeCapacity<<std::endl;
+	}
+
+	if(stats.shards > 1){
+		out<<"threads: "<<threads<<std::endl
+		<<"shards: "<<stats.shards<<std::endl
+		<<"partitioning time: "<<time_to_string(stats.partitionTime)<<std::endl
+		<<"shards build time: "<<time_to_string(stats.shardsTime)<<" (single thread work: "<<time_to_string(stats.shardsWork)<<")"<<std::endl
+		<<"scaling efficiency: "<<stats.shardsWork / (stats.shardsTime * threads) * 100<<"%"<<std::endl;
+	}
+
+	if(spatial::PHASE_TIMERS){
+		phase_breakdown(out, phasesBefore, spatial::threadPhaseTotals(), duration.count(), 1);
+	}
+
+	if(record){
+		record->command = "build";
+		record->dataset = dataset.name;
+		record->index = name;
+		record->threads = threads;
+		record->operations = dataset.geometries.size();
+		record->throughput = duration.count() > 0 ? dataset.geometries.size() / (duration.count() / 1000.0) : 0;
+		// peak growth of the process, temporary buffers included
+		const std::uint64_t peak = std::max(spatial::peakResidentBytes(), spatial::residentBytes());
+		record->memory = peak > residentBefore ? peak - residentBefore : 0;
+	}
+
+	return true;
+}
+
+// Runs the task on its own thread; its report is printed by `wait`.
+void run_in_background(std::function<std::string()> task){
+
+	std::lock_guard<std::mutex> lock(backgroundTasksMutex);
+	backgroundTasks.push_back(std::async(std::launch::async, std::move(task)));
+}
+
+void cmd_build(std::ostream& out, const std::string& type, const std::size_t threads, const std::string& datasetName, const bool background, spatial::ReportWriter* report, const std::string& indexName, const spatial::IndexParams& params){
+	
+	if(!isValidType(type)){
+		out<<"Error: Invalid data structure type '"<<type<<"'"<<std::endl;
+		return;
+	}
+
+	// an index is named after its type unless given another name, which must
+	// not be a type itself
+	const std::string name = indexName.empty() ? type : indexName;
+
+	if(name != type && (isValidType(name) || type == "linear")){
+		out<<"Error: cannot build a "<<type<<" as '"<<name<<"'"<<std::endl;
+		return;
+	}
+	if(params.nodeCapacity < 2){
+		out<<"Error: the node capacity must be at least 2"<<std::endl;
+		return;
+	}
+	if(type != "r-tree" && !(params == spatial::IndexParams{})){
+		out<<"Error: only the r-tree takes a node capacity"<<std::endl;
+		return;
+	}
+
+	const std::shared_ptr<spatial::Dataset> dataset = find_dataset(out, datasetName);
+
+	if(!dataset){
+		return;
+	}
+	if(dataset->geometries.empty()){
+		out<<"Error: no geometries loaded"<<std::endl;
+		return;
+	}
+
+	const std::string existing = dataset->indexes.typeOf(name);
+	if(!existing.empty() && existing != type){
+		out<<"Error: '"<<name<<"' is already a "<<existing<<std::endl;
+		return;
+	}
+
+	if(!background){
+		spatial::BenchRecord record;
+		if(build_report(out, *dataset, name, type, params, threads, &record) && report){
+			report->write(record);
+		}
+		return;
+	}
+
+	// queries keep using the current index until the new one is published
+	auto pending = std::make_shared<spatial::IndexRegistry::PendingBuild>(dataset->indexes);
+	run_in_background([dataset, name, type, params, threads, pending]() mutable{
+		// released when the task ends, however it ends
+		const auto done = std::move(pending);
+		std::ostringstream report;
+		report<<"background build of "<<name<<" on "<<dataset->name<<std::endl;
+		build_report(report, *dataset, name, type, params, threads);
+		return report.str();
+	});
+
+	out<<"building "<<name<<" on "<<dataset->name<<" in the background"<<std::endl;
+}
+
+void cmd_build(std::ostream& out, const std::vector<std::string>& args){
+
+	const spatial::Options options(args, {"as", "node-capacity", "threads", "dataset", "report"}, {"background"});
+
+	if(options.positional().size() != 1){
+		out<<"Error: expected build <type> [--as name] [--node-capacity N] [--threads N] [--dataset name] [--background | --report file]"<<std::endl;
+		return;
+	}
+
+	if(options.has("as") && options.get<std::string>("as", "").empty()){
+		out<<"Error: --as needs a name"<<std::endl;
+		return;
+	}
+
+	spatial::IndexParams params;
+	params.nodeCapacity = options.get<std::size_t>("node-capacity", params.nodeCapacity);
+
+	const std::size_t threads = options.get<std::size_t>("threads", 1);
+
+	if(threads == 0){
+		out<<"Error: --threads must be at least 1"<<std::endl;
+		return;
+	}
+
+	std::unique_ptr<spatial::ReportWriter> report;
+	if(options.has("report")){
+		if(options.has("background")){
+			out<<"Error: --report cannot be used with --background"<<std::endl;
+			return;
+		}
+		report = std::make_unique<spatial::ReportWriter>(options.get<std::string>("report", ""));
+		if(!report->good()){
+			out<<"Error: cannot write '"<<options.get<std::string>("report", "")<<"'"<<std::endl;
+			return;
+		}
+	}
+
+	cmd_build(out, options.positional()[0], threads, options.get<std::string>("dataset", ""), options.has("background"), report.get(), options.get<std::string>("as", ""), params);
+}
+
+// Cells of the result cache: about a millionth of the extent unless set.
+double result_cache_resolution(const spatial::Dataset& dataset){
+
+	if(resultCacheResolution > 0){
+		return resultCacheResolution;
+	}
+	const double extent = std::max(dataset.maxX - dataset.minX, dataset.maxY - dataset.minY);
+	return extent > 0 ? extent / (1 << 20) : 1;
+}
+
+// Whether an index of that type can be built on the geometries of the dataset:
+// the kd-tree and geohash index points only.
+bool supportsGeometries(const spatial::Dataset& dataset, const std::string& type){
+
+	if(type != "kd-tree" && type != "geohash"){
+		return true;
+	}
+	return std::all_of(dataset.geometries.begin(), dataset.geometries.end(), [](const std::shared_ptr<geos::geom::Geometry>& geom){
+		return geom->getGeometryTypeId() == geos::geom::GEOS_POINT;
+	});
+}
+
+// Publishes the dataset under its name. With carryIndexes, for replacements
+// made while queries run, the indexes of the dataset it replaces are built on
+// the new geometries first, so the queries switch from the old indexed dataset
+// to the new indexed one.
+void publish_dataset(std::ostream& out, std::shared_ptr<spatial::Dataset> dataset, const std::size_t threads, const bool activate, const bool carryIndexes){
+
+	// the cache of the replaced dataset goes with it
+	dataset->resultCache.configure(resultCacheBudget, result_cache_resolution(*dataset));
+
+	const std::shared_ptr<spatial::Dataset> previous = carryIndexes ? datasets.get(dataset->name) : nullptr;
+	if(previous){
+		for(const std::string& name : previous->indexes.available()){
+
+			const std::shared_ptr<spatial::IndexSlot> slot = previous->indexes.find(name);
+			if(!slot){
+				continue;
+			}
+			if(!supportsGeometries(*dataset, slot->type)){
+				out<<name<<" not carried over: the "<<slot->type<<" needs points"<<std::endl;
+				continue;
+			}
+			build_report(out, *dataset, name, slot->type, slot->params, threads);
+		}
+	}
+
+	datasets.put(std::move(dataset), activate);
+}
+
+// Reads the shapefile into a new dataset and publishes it under the name.
+bool load_dataset(std::ostream& out, const std::string& inputFile, const std::string& name, const std::size_t threads, const bool activate, const bool carryIndexes){
+
+	std::vector<std::shared_ptr<geos::geom::Geometry>> geometries;
+	spatial::AttributeTable attributes;
+
+	if(!readShapeFile(inputFile, geometries, &attributes)){
+		out<<"Error: cannot read '"<<inputFile<<"'"<<std::endl;
+		return false;
+	}
+
+	publish_dataset(out, std::make_shared<spatial::Dataset>(name, std::move(geometries), preparedCacheCapacity, std::move(attributes)), threads, activate, carryIndexes);
+
+	return true;
+}
+
+// Generates a synthetic layer and publishes it like a loaded one.
+void cmd_generate(std::ostream& out, const std::vector<std::string>& args){
+
+	const spatial::Options options(args, {"layout", "seed", "extent", "clusters", "spread", "size", "skew", "overlap", "as", "threads"});
+	const std::vector<std::string>& positional = options.positional();
+
+	if(positional.size() != 2){
+		out<<"Error: expected generate <points|lines|polygons> <count> [--layout uniform|clusters|roads|overlapping] [--seed S] [--size F] [--skew S] [--as name] [--threads N]"<<std::endl;
+		return;
+	}
+
+	spatial::LayerSpec spec;
+
+	if(!spatial::parseFeatureKind(positional[0], spec.kind)){
+		out<<"Error: invalid kind '"<<positional[0]<<"', expected points|lines|polygons"<<std::endl;
+		return;
+	}
+
+	// accepts 1e6 as well; bounded first, as the cast of a larger count is undefined
+	const double count = spatial::parseValue<double>("count", positional[1]);
+	if(count < 1 || count != std::floor(count) || count >= std::ldexp(1.0, std::numeric_limits<std::size_t>::digits)){
+		out<<"Error: the count must be a positive integer"<<std::endl;
+		return;
+	}
+	spec.count = static_cast<std::size_t>(count);
+
+	const std::string layout = options.get<std::string>("layout", "uniform");
+	if(!spatial::parseLayout(layout, spec.layout)){
+		out<<"Error: invalid layout '"<<layout<<"', expected uniform|clusters|roads|overlapping"<<std::endl;
+		return;
+	}
+	if(spec.layout == spatial::Layout::overlapping && spec.kind == spatial::FeatureKind::points){
+		out<<"Error: the overlapping layout needs lines or polygons"<<std::endl;
+		return;
+	}
+
+	spec.seed = options.get<std::uint64_t>("seed", spec.seed);
+	spec.extent = options.get<double>("extent", spec.extent);
+	spec.clusters = options.get<std::size_t>("clusters", spec.clusters);
+	spec.spread = options.get<double>("spread", spec.spread);
+	spec.size = options.get<double>("size", spec.size);
+	spec.skew = options.get<double>("skew", spec.skew);
+	spec.overlap = options.get<double>("overlap", spec.overlap);
+
+	const std::string name = options.get<std::string>("as", "default");
+	const std::size_t threads = options.get<std::size_t>("threads", 1);
+
+	if(name.empty()){
+		out<<"Error: --as needs a name"<<std::endl;
+		return;
+	}
+	if(threads == 0 || spec.clusters == 0 || !(spec.extent > 0) || !(spec.spread > 0) || !(spec.size > 0) || !(spec.overlap > 0) || !(spec.skew >= 0)){
+		out<<"Error: --threads, --clusters, --extent, --spread, --size and --overlap must be positive and --skew not negative"<<std::endl;
+		return;
+	}
+
+	spatial::ThreadPool pool(threads);
+	spatial::AttributeTable attributes;
+
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<std::shared_ptr<geos::geom::Geometry>> geometries = spatial::generateLayer(spec, attributes, &pool);
+	const std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start;
+
+	out<<"generated "<<spatial::describe(spec)<<" in "<<time_to_string(duration.count())<<std::endl;
+
+	publish_dataset(out, std::make_shared<spatial::Dataset>(name, std::move(geometries), preparedCacheCapacity, std::move(attributes)), threads, true, false);
+}
+
+void cmd_load(std::ostream& out, const std::string& inputFile, const std::string& name){
+	load_dataset(out, inputFile, name, 1, true, false);
+}
+
+void cmd_load(std::ostream& out, const std::vector<std::string>& args){
+
+	const spatial::Options options(args, {"as", "threads"}, {"background"});
+
+	if(options.positional().size() != 1){
+		out<<"Error: expected load <file.shp> [--as name] [--threads N] [--background]"<<std::endl;
+		return;
+	}
+
+	const std::string name = options.get<std::string>("as", "default");
+	const std::size_t threads = options.get<std::size_t>("threads", 1);
+
+	if(name.empty()){
+		out<<"Error: --as needs a name"<<std::endl;
+		return;
+	}
+	if(threads == 0){
+		out<<"Error: --threads must be at least 1"<<std::endl;
+		return;
+	}
+
+	if(!options.has("background")){
+		load_dataset(out, options.positional()[0], name, threads, true, false);
+		return;
+	}
+
+	// the active dataset stays the same until the user picks the new one
+	run_in_background([inputFile = options.positional()[0], name, threads](){
+		std::ostringstream report;
+		report<<"background load of "<<inputFile<<" as "<<name<<std::endl;
+		if(load_dataset(report, inputFile, name, threads, false, true)){
+			report<<name<<" replaced"<<std::endl;
+		}
+		return report.str();
+	});
+
+	out<<"loading "<<options.positional()[0]<<" as "<<name<<" in the background"<<std::endl;
+}
+
+void cmd_datasets(std::ostream& out){
+
+	const std::string active = datasets.activeName();
+
+	for(const std::shared_ptr<spatial::Dataset>& dataset : datasets.list()){
+
+		out<<(dataset->name == active ? "* " : "  ")<<dataset->name<<": "<<dataset->geometries.size()<<" geometries, indexes:";
+		for(const std::string& type : dataset->indexes.available()){
+			out<<" "<<type;
+		}
+		if(dataset->indexes.pendingBuilds > 0){
+			out<<" ("<<dataset->indexes.pendingBuilds<<" building)";
+		}
+		out<<std::endl;
+	}
+}
+
+void print_index_stats(std::ostream& out, const std::string& type, const spatial::IndexStats& stats, const std::uint64_t heapGrowth){
+
+	const double features = std::max<double>(stats.entries, 1);
+
+	out<<type<<": "<<stats.entries<<" entries"<<std::endl
+	<<"  memory: "<<bytes_to_string(stats.totalBytes())<<" ("<<stats.totalBytes() / features<<" bytes per entry): nodes "<<bytes_to_string(stats.nodeBytes)
+	<<", items "<<bytes_to_string(stats.itemBytes)<<", keys "<<bytes_to_string(stats.keyBytes)<<", allocator overhead "<<bytes_to_string(stats.overheadBytes)<<std::endl;
+
+	if(heapGrowth > 0){
+		out<<"  heap growth of the build: "<<bytes_to_string(heapGrowth)<<" ("<<heapGrowth / features<<" bytes per entry)"<<std::endl;
+	}
+
+	out<<"  depth: "<<stats.depth;
+	if(stats.nodes > 0){
+		out<<", nodes: "<<stats.nodes;
+	}
+	if(stats.fanout > 0){
+		out<<", fanout: "<<stats.fanout;
+	}
+	if(stats.leaves > 0){
+		out<<", leaves: "<<stats.leaves<<", leaf occupancy: "<<stats.occupancy * 100<<"%, sibling overlap: "<<stats.overlap * 100<<"%";
+	}
+	out<<std::endl;
+
+	if(!stats.note.empty()){
+		out<<"  note: "<<stats.note<<std::endl;
+	}
+}
+
+// Prints the memory each index of the dataset takes, accounted from its
+// structure and measured as the heap growth of its build, and its shape.
+void cmd_stats(std::ostream& out, const std::vector<std::string>& args){
+
+	const spatial::Options options(args, {"dataset"});
+
+	if(!options.positional().empty()){
+		out<<"Error: expected stats [--dataset name]"<<std::endl;
+		return;
+	}
+
+	const std::shared_ptr<spatial::Dataset> dataset = find_dataset(out, options.get<std::string>("dataset", ""));
+
+	if(!dataset){
+		return;
+	}
+
+	const spatial::IndexStats table = spatial::envelopeTableStats(dataset->envelopeTable);
+	out<<"dataset "<<dataset->name<<": "<<dataset->geometries.size()<<" geometries"<<std::endl
+	<<"envelope table (shared): "<<bytes_to_string(table.totalBytes())<<", "<<spatial::EnvelopeTable::kernelName()<<" kernel"<<std::endl;
+
+	const spatial::ResultCache::Statistics cache = dataset->resultCache.statistics();
+	if(cache.budget == 0){
+		out<<"result cache: off"<<std::endl;
+	}else{
+		out<<"result cache: "<<cache.entries<<" entries, "<<bytes_to_string(cache.bytes)<<" of "<<bytes_to_string(cache.budget)
+		<<", resolution "<<cache.resolution<<std::endl
+		<<"  hits: "<<cache.hits<<", misses: "<<cache.lookups - cache.hits;
+		if(cache.lookups > 0){
+			out<<" ("<<100.0 * cache.hits / cache.lookups<<"% hits)";
+		}
+		out<<", evicted: "<<cache.evicted<<", invalidated: "<<cache.invalidated<<std::endl;
+	}
+
+	const spatial::IndexRegistry& indexes = dataset->indexes;
+
+	for(const std::string& name : indexes.available()){
+
+		const std::shared_ptr<spatial::IndexSlot> slot = indexes.find(name);
+		if(!slot){
+			continue;
+		}
+
+		if(const auto kdTree = slot->kdTree.load()){
+			print_index_stats(out, name, spatial::kdTreeStats(*kdTree), indexes.heapGrowth(name));
+		}
+		if(const auto quadTree = slot->quadTree.load()){
+			print_index_stats(out, name, spatial::quadTreeStats(*quadTree), indexes.heapGrowth(name));
+		}
+		if(const auto rTree = slot->rTree.load()){
+			print_index_stats(out, name, spatial::rTreeStats(*rTree), indexes.heapGrowth(name));
+		}
+		if(const auto geohash = slot->geohash.load()){
+			print_index_stats(out, name, spatial::geohashStats(*geohash), indexes.heapGrowth(name));
+		}
+		if(const auto aggregateRTree = slot->aggregateRTree.load()){
+			print_index_stats(out, name, spatial::aggregateTreeStats(*aggregateRTree), indexes.heapGrowth(name));
+		}
+	}
+}
+
+// Sets the result cache of every dataset, loaded or to come.
+void cmd_cache(std::ostream& out, const std::vector<std::string>& args){
+
+	const spatial::Options options(args, {"resolution"});
+
+	if(options.positional().size() != 1){
+		out<<"Error: expected cache <MiB>|off|clear [--resolution R]"<<std::endl;
+		return;
+	}
+
+	const std::string& budget = options.positional()[0];
+
+	if(budget == "clear"){
+		for(const std::shared_ptr<spatial::Dataset>& dataset : datasets.list()){
+			dataset->resultCache.clear();
+		}
+		out<<"result cache cleared"<<std::endl;
+		return;
+	}
+
+	const double megabytes = budget == "off" ? 0 : spatial::parseValue<double>("budget", budget);
+	const double resolution = options.get<double>("resolution", 0);
+
+	if(megabytes < 0 || resolution < 0){
+		out<<"Error: the budget and the resolution cannot be negative"<<std::endl;
+		return;
+	}
+
+	resultCacheBudget = static_cast<std::size_t>(megabytes * 1024 * 1024);
+	resultCacheResolution = resolution;
+
+	for(const std::shared_ptr<spatial::Dataset>& dataset : datasets.list()){
+		dataset->resultCache.configure(resultCacheBudget, result_cache_resolution(*dataset));
+	}
+
+	if(resultCacheBudget == 0){
+		out<<"result cache: off"<<std::endl;
+	}else{
+		out<<"result cache: "<<bytes_to_string(resultCacheBudget)<<" per dataset"<<std::endl;
+	}
+}
+
+// Waits for the background loads and builds and prints their reports.
+void cmd_wait(std::ostream& out){
+
+	std::vector<std::future<std::string>> tasks;
+	{
+		std::lock_guard<std::mutex> lock(backgroundTasksMutex);
+		tasks.swap(backgroundTasks);
+	}
+
+	for(std::future<std::string>& task : tasks){
+		out<<task.get();
+	}
+}
+
+template<typename F>
+class ItemVisitorAdapter : public geos::index::ItemVisitor{
+public:
+	explicit ItemVisitorAdapter(F& f) : f(f) {}
+
+	void visitItem(void* item) override{
+		f(reinterpret_cast<std::size_t>(item));
+	}
+
+private:
+	F& f;
+};
+
+template<typename F>
+class KdNodeVisitorAdapter : public geos::index::kdtree::KdNodeVisitor{
+public:
+	explicit KdNodeVisitorAdapter(F& f) : f(f) {}
+
+	void visit(geos::index::kdtree::KdNode* node) override{
+		f(reinterpret_cast<std::size_t>(node->getData()));
+	}
+
+private:
+	F& f;
+};
+
+// Geohash cells covering the envelope, found through the circle around it.
+GeoHash::HashVector geohash_cells(const geos::geom::Envelope& envelope){
+
+	const GeoHash::Point center = {envelope.getMinY() + (envelope.getHeight()/2), 
+								   envelope.getMinX() + (envelope.getWidth()/2)};
+
+	const double radius = GeoHash::distance(envelope.getMinY(), envelope.getMinX(), envelope.getMaxY(), envelope.getMaxX(), GeoHash::EARTH_METERS)*2;
+
+	return GeoHash::nearbyCells(center, radius, GeoHash::EARTH_METERS);
+}
+
+// Calls f(geomIdx) for every geometry whose geohash starts with the cell hash.
+template<typename F>
+void geohash_visit_cell(const spatial::GeohashIndex& geohash, const std::string_view cellHash, F&& f){
+
+	auto compare = [](const std::pair<std::string, std::size_t>& pair, const std::string_view str){
+		return std::string_view(pair.first) < str;
+	};
+
+	auto it = std::lower_bound(geohash.begin(), geohash.end(), cellHash, compare);
+	while (it != geohash.end() && it->first.starts_with(cellHash)){
+		f(it->second);
+		++it;
+	}
+}
+
+// Thrown by a search visitor that has seen enough results. The GEOS indexes
+// cannot abandon a traversal from inside a visitor, so the search unwinds out
+// of it instead and returns normally.
+struct SearchStopped{};
+
+// Calls visitor(geomIdx) for every geometry whose envelope passes the filter
+// against the search envelope. Candidates are refined against the envelope
+// table in small batches as the index reports them, so no candidate list is
+// allocated. The visitor can end the search early by throwing SearchStopped.
+template<typename Visitor>
+bool search_envelope(const spatial::Dataset& dataset, const std::string& index, const geos::geom::Envelope& envelope, const spatial::EnvelopePredicate filter, Visitor&& visitor){
+
+	const std::shared_ptr<spatial::IndexSlot> slot = dataset.indexes.find(index);
+	if(!slot && index != "linear"){
+		return false;
+	}
+	const std::string& type = slot ? slot->type : index;
+
+	spatial::RefineBuffer<Visitor> refineBuffer(dataset.envelopeTable, filter, envelope, visitor);
+
+	auto refine = [&refineBuffer](const std::size_t geomIdx){
+		searchCandidates++;
+		refineBuffer.push(geomIdx);
+	};
+
+	spatial::ScopedPhase phase(spatial::Phase::traversal);
+
+	try{
+		// every index is used through the snapshot taken here, even if a rebuild
+		// publishes a new one while the query runs
+		if(type == "kd-tree"){
+
+			const auto kdTree = slot->kdTree.load();
+			if(!kdTree){
+				return false;
+			}
+
+			KdNodeVisitorAdapter<decltype(refine)> kdVisitor(refine);
+			kdTree->query(envelope, kdVisitor);
+
+		}else if(type == "quad-tree"){
+		
+			const auto quadTree = slot->quadTree.load();
+			if(!quadTree){
+				return false;
+			}
+
+			ItemVisitorAdapter<decltype(refine)> itemVisitor(refine);
+			quadTree->query(&envelope, itemVisitor);
+
+		}else if(type == "r-tree"){
+		
+			const auto rTree = slot->rTree.load();
+			if(!rTree){
+				return false;
+			}
+
+			ItemVisitorAdapter<decltype(refine)> itemVisitor(refine);
+			rTree->query(&envelope, itemVisitor);
+
+		}else if(type == "geohash"){
+		
+			const auto geohash = slot->geohash.load();
+			if(!geohash){
+				return false;
+			}
+
+			for(const std::string_view cellHash : geohash_cells(envelope)){
+				geohash_visit_cell(*geohash, cellHash, refine);
+			}
+
+		}else if(type == "aggregate-r-tree"){
+
+			const auto aggregateRTree = slot->aggregateRTree.load();
+			if(!aggregateRTree){
+				return false;
+			}
+
+			aggregateRTree->query(envelope, refine);
+
+	    }else if(type == "linear"){
+
+			searchCandidates += dataset.envelopeTable.size();
+
+			// the scan is all envelope tests
+			spatial::ScopedPhase scanPhase(spatial::Phase::envelopeRefine);
+			dataset.envelopeTable.scan(filter, envelope, visitor);
+	    }
+
+		refineBuffer.flush();
+
+	}catch(const SearchStopped&){
+		// the visitor has enough results
+	}
+
+	return true;
+}
+
+// Calls visitor(geomIdx) for every geometry whose envelope is contained in the
+// search envelope.
+template<typename Visitor>
+bool search(const spatial::Dataset& dataset, const std::string& type, const geos::geom::Envelope& envelope, Visitor&& visitor){
+	return search_envelope(dataset, type, envelope, spatial::EnvelopePredicate::contains, visitor);
+}
+
+// Two-phase search: the index and the envelope table filter the candidates,
+// then the predicate is evaluated on the real geometries.
+template<typename Visitor>
+bool search(const spatial::Dataset& dataset, const std::string& type, const spatial::QueryRegion& region, const spatial::Predicate predicate, Visitor&& visitor){
+
+	if(predicate == spatial::Predicate::bbox){
+		return search(dataset, type, region.getEnvelope(), visitor);
+	}
+
+	auto refine = [&dataset, &region, predicate, &visitor](const std::size_t geomIdx){
+		bool matches;
+		{
+			spatial::ScopedPhase phase(spatial::Phase::exactRefine);
+			matches = spatial::evaluate(predicate, region, geomIdx, *dataset.geometries[geomIdx], dataset.preparedCache.get());
+		}
+		if(matches){
+			visitor(geomIdx);
+		}
+	};
+
+	return search_envelope(dataset, type, region.getEnvelope(), spatial::envelopeFilter(predicate), refine);
+}
+
+template<typename Visitor>
+bool search(const spatial::Dataset& dataset, const std::string& type, const geos::geom::Envelope& envelope, const spatial::Predicate predicate, Visitor&& visitor){
+
+	if(predicate == spatial::Predicate::bbox){
+		return search(dataset, type, envelope, visitor);
+	}
+	return search(dataset, type, spatial::QueryRegion(envelope), predicate, visitor);
+}
+
+// Fills the caller-owned buffer with the geometries found; the buffer is
+// cleared but keeps its capacity, so it can be reused across queries.
+bool search(const spatial::Dataset& dataset, const std::string& type, const geos::geom::Envelope& envelope, std::vector<std::size_t>& geometriesFound){
+
+    geometriesFound.clear();
+
+	return search(dataset, type, envelope, [&geometriesFound](const std::size_t geomIdx){
+		geometriesFound.push_back(geomIdx);
+	});
+}
+
+bool search(const spatial::Dataset& dataset, const std::string& type, const geos::geom::Envelope& envelope, const spatial::Predicate predicate, std::vector<std::size_t>& geometriesFound){
+
+    geometriesFound.clear();
+
+	return search(dataset, type, envelope, predicate, [&geometriesFound](const std::size_t geomIdx){
+		geometriesFound.push_back(geomIdx);
+	});
+}
+
+struct PolygonSearchStats{
+	std::size_t nodesInside = 0;
+	std::size_t nodesOutside = 0;
+	std::size_t nodesBoundary = 0;
+	std::size_t accepted = 0;	// geometries taken from inside nodes without refinement
+	std::size_t refined = 0;	// geometries that went through the exact predicate
+};
+
+spatial::Coverage classify_node(const spatial::QueryRegion& region, const geos::geom::Envelope& envelope, PolygonSearchStats& stats){
+
+	const spatial::Coverage coverage = region.classify(envelope);
+
+	switch(coverage){
+	case spatial::Coverage::inside:
+		stats.nodesInside++;
+		break;
+	case spatial::Coverage::outside:
+		stats.nodesOutside++;
+		break;
+	case spatial::Coverage::boundary:
+		stats.nodesBoundary++;
+		break;
+	}
+
+	return coverage;
+}
+
+template<typename F>
+void visit_str_items(geos::index::strtree::AbstractNode* node, F& f){
+
+	for(geos::index::strtree::Boundable* child : *node->getChildBoundables()){
+		if(auto* childNode = dynamic_cast<geos::index::strtree::AbstractNode*>(child)){
+			visit_str_items(childNode, f);
+		}else{
+			f(reinterpret_cast<std::size_t>(static_cast<geos::index::strtree::ItemBoundable*>(child)->getItem()));
+		}
+	}
+}
+
+template<typename Accept, typename Candidate>
+void visit_str_node(geos::index::strtree::AbstractNode* node, const spatial::QueryRegion& region, Accept& accept, Candidate& candidate, PolygonSearchStats& stats){
+
+	for(geos::index::strtree::Boundable* child : *node->getChildBoundables()){
+
+		auto* childNode = dynamic_cast<geos::index::strtree::AbstractNode*>(child);
+		if(!childNode){
+			candidate(reinterpret_cast<std::size_t>(static_cast<geos::index::strtree::ItemBoundable*>(child)->getItem()));
+			continue;
+		}
+
+		switch(classify_node(region, *static_cast<const geos::geom::Envelope*>(childNode->getBounds()), stats)){
+		case spatial::Coverage::inside:
+			visit_str_items(childNode, accept);
+			break;
+		case spatial::Coverage::boundary:
+			visit_str_node(childNode, region, accept, candidate, stats);
+			break;
+		case spatial::Coverage::outside:
+			break;
+		}
+	}
+}
+
+// Search with an arbitrary polygon. Where the index exposes its nodes (r-tree
+// nodes, sharded tree extents, geohash cells) they are classified against the
+// prepared polygon: outside nodes are skipped and the geometries of inside
+// nodes are reported without refinement. Only intersects and within can use
+// inside nodes; the other predicates take the plain two-phase search.
+template<typename Visitor>
+bool search_polygon(const spatial::Dataset& dataset, const std::string& index, const spatial::QueryRegion& region, const spatial::Predicate predicate, Visitor&& visitor, PolygonSearchStats& stats){
+
+	if(!dataset.indexes.isBuilt(index)){
+		return false;
+	}
+
+	// search() refines the candidates with the predicate itself
+	if(predicate != spatial::Predicate::intersects && predicate != spatial::Predicate::within){
+		return search(dataset, index, region, predicate, visitor);
+	}
+
+	const std::shared_ptr<spatial::IndexSlot> slot = dataset.indexes.find(index);
+	const std::string& type = slot ? slot->type : index;
+
+	auto exact = [&dataset, &region, predicate, &visitor, &stats](const std::size_t geomIdx){
+		stats.refined++;
+		if(spatial::evaluate(predicate, region, geomIdx, *dataset.geometries[geomIdx], dataset.preparedCache.get())){
+			visitor(geomIdx);
+		}
+	};
+
+	spatial::RefineBuffer<decltype(exact)> refineBuffer(dataset.envelopeTable, spatial::envelopeFilter(predicate), region.getEnvelope(), exact);
+
+	auto candidate = [&refineBuffer](const std::size_t geomIdx){
+		refineBuffer.push(geomIdx);
+	};
+	auto accept = [&visitor, &stats](const std::size_t geomIdx){
+		stats.accepted++;
+		visitor(geomIdx);
+	};
+
+	if(type == "r-tree"){
+
+		slot->rTree.load()->forEachShard([&](const geos::geom::Envelope& extent, geos::index::strtree::STRtree& tree){
+
+			geos::index::strtree::AbstractNode* root = tree.getRoot();
+			if(!root){
+				return;
+			}
+
+			switch(classify_node(region, extent, stats)){
+			case spatial::Coverage::inside:
+				visit_str_items(root, accept);
+				break;
+			case spatial::Coverage::boundary:
+				visit_str_node(root, region, accept, candidate, stats);
+				break;
+			case spatial::Coverage::outside:
+				break;
+			}
+		});
+
+	}else if(type == "quad-tree"){
+
+		// GEOS does not expose the quadtree nodes, only the shard extents
+		ItemVisitorAdapter<decltype(accept)> acceptVisitor(accept);
+		ItemVisitorAdapter<decltype(candidate)> candidateVisitor(candidate);
+
+		slot->quadTree.load()->forEachShard([&](const geos::geom::Envelope& extent, geos::index::quadtree::Quadtree& tree){
+
+			switch(classify_node(region, extent, stats)){
+			case spatial::Coverage::inside:
+				tree.query(&extent, acceptVisitor);
+				break;
+			case spatial::Coverage::boundary:
+				tree.query(&region.getEnvelope(), candidateVisitor);
+				break;
+			case spatial::Coverage::outside:
+				break;
+			}
+		});
+
+	}else if(type == "geohash"){
+
+		const auto geohash = slot->geohash.load();
+
+		for(const std::string_view cellHash : geohash_cells(region.getEnvelope())){
+
+			const GeoHash::Rectangle cell = GeoHash::decode(cellHash);
+
+			switch(classify_node(region, geos::geom::Envelope(cell.w_lon(), cell.e_lon(), cell.s_lat(), cell.n_lat()), stats)){
+			case spatial::Coverage::inside:
+				geohash_visit_cell(*geohash, cellHash, accept);
+				break;
+			case spatial::Coverage::boundary:
+				geohash_visit_cell(*geohash, cellHash, candidate);
+				break;
+			case spatial::Coverage::outside:
+				break;
+			}
+		}
+
+	}else{
+
+		// the kd-tree and the linear scan have no nodes to classify
+		search_envelope(dataset, index, region.getEnvelope(), spatial::envelopeFilter(predicate), candidate);
+	}
+
+	refineBuffer.flush();
+
+	return true;
+}
+
+// Results of a batch of queries in compressed sparse row form: the geometries
+// found by query q are ids[offsets[q]] .. ids[offsets[q+1] - 1].
+struct BatchResult{
+	std::vector<std::size_t> offsets;
+	std::vector<std::size_t> ids;
+};
+
+// Indices [0, count) sorted along a Hilbert curve over the loaded extent,
+// using position(i) -> (x, y) as the location of item i.
+template<typename Position>
+std::vector<std::size_t> hilbert_order(const spatial::Dataset& dataset, const std::size_t count, spatial::ThreadPool& pool, Position position){
+
+	const spatial::HilbertCurve curve(dataset.minX, dataset.minY, dataset.maxX, dataset.maxY);
+
+	std::vector<std::pair<std::uint64_t, std::size_t>> keys(count);
+	pool.parallelFor(count, 4096, [&](std::size_t, const std::size_t i){
+		const auto [x, y] = position(i);
+		keys[i] = {curve.index(x, y), i};
+	});
+	spatial::parallelSort(pool, keys.begin(), keys.end(), std::less<>());
+
+	std::vector<std::size_t> order(count);
+	for(std::size_t k = 0; k < count; k++){
+		order[k] = keys[k].second;
+	}
+	return order;
+}
+
+// Runs every query of the batch and stores the results in the order of the
+// envelopes. The queries are processed along a Hilbert curve over their
+// centres, in runs of consecutive queries per worker, so that each worker
+// keeps hitting the same index nodes.
+bool search_batch(const spatial::Dataset& dataset, const std::string& type, const std::vector<geos::geom::Envelope>& envelopes, const spatial::Predicate predicate, spatial::ThreadPool& pool, BatchResult& result){
+
+	if(!dataset.indexes.isBuilt(type)){
+		return false;
+	}
+
+	const std::size_t count = envelopes.size();
+
+	const std::vector<std::size_t> order = hilbert_order(dataset, count, pool, [&envelopes](const std::size_t q){
+		return std::make_pair((envelopes[q].getMinX() + envelopes[q].getMaxX()) / 2, (envelopes[q].getMinY() + envelopes[q].getMaxY()) / 2);
+	});
+
+	constexpr std::size_t runSize = 64;
+	const std::size_t runs = (count + runSize - 1) / runSize;
+
+	// each run appends its ids to the buffer of the worker that ran it
+	std::vector<std::vector<std::size_t>> workerIds(pool.size());
+	std::vector<std::pair<std::size_t, std::size_t>> runSource(runs);
+	std::vector<std::size_t> counts(count);
+
+	pool.parallelFor(runs, 1, [&](const std::size_t worker, const std::size_t run){
+
+		std::vector<std::size_t>& ids = workerIds[worker];
+		runSource[run] = {worker, ids.size()};
+
+		for(std::size_t k = run * runSize; k < std::min(count, (run + 1) * runSize); k++){
+			const std::size_t before = ids.size();
+			search(dataset, type, envelopes[order[k]], predicate, [&ids](const std::size_t geomIdx){
+				ids.push_back(geomIdx);
+			});
+			counts[order[k]] = ids.size() - before;
+		}
+	});
+
+	result.offsets.resize(count + 1);
+	result.offsets[0] = 0;
+	std::inclusive_scan(counts.begin(), counts.end(), result.offsets.begin() + 1);
+	result.ids.resize(result.offsets[count]);
+
+	pool.parallelFor(runs, 1, [&](std::size_t, const std::size_t run){
+
+		const std::size_t* source = workerIds[runSource[run].first].data() + runSource[run].second;
+
+		for(std::size_t k = run * runSize; k < std::min(count, (run + 1) * runSize); k++){
+			const std::size_t q = order[k];
+			std::copy_n(source, counts[q], result.ids.begin() + result.offsets[q]);
+			source += counts[q];
+		}
+	});
+
+	return true;
+}
+
+// For every point, the smallest index of the loaded polygons covering it, or
+// -1. Candidates come from the r-tree and are refined with point-in-polygon
+// tests; the points are processed in Hilbert order, in runs per worker.
+bool locate_points(const spatial::Dataset& dataset, const std::vector<geos::geom::CoordinateXY>& points, spatial::PolygonLayerLocator& locator, spatial::ThreadPool& pool, std::vector<std::int64_t>& owners){
+
+	const std::shared_ptr<spatial::IndexSlot> slot = dataset.indexes.find("r-tree");
+	const auto rTree = slot ? slot->rTree.load() : nullptr;
+	if(!rTree){
+		return false;
+	}
+
+	const std::vector<std::size_t> order = hilbert_order(dataset, points.size(), pool, [&points](const std::size_t p){
+		return std::make_pair(points[p].x, points[p].y);
+	});
+
+	owners.assign(points.size(), -1);
+
+	pool.parallelFor(points.size(), 256, [&](std::size_t, const std::size_t k){
+
+		const geos::geom::CoordinateXY& point = points[order[k]];
+		std::int64_t& owner = owners[order[k]];
+
+		auto refine = [&locator, &point, &owner](const std::size_t geomIdx){
+			if((owner < 0 || static_cast<std::int64_t>(geomIdx) < owner) && locator.covers(geomIdx, point)){
+				owner = static_cast<std::int64_t>(geomIdx);
+			}
+		};
+
+		const geos::geom::Envelope envelope(point.x, point.x, point.y, point.y);
+		ItemVisitorAdapter<decltype(refine)> itemVisitor(refine);
+		rTree->query(&envelope, itemVisitor);
+	});
+
+	return true;
+}
+
+// The k geometries nearest to (x, y) as (distance, geomIdx), closest first.
+// The search box starts with the size expected to hold k geometries and
+// doubles until the k-th distance fits in it: a geometry closer than half
+// the box side always has its envelope in the box.
+bool search_knn(const spatial::Dataset& dataset, const std::string& type, const double x, const double y, const std::size_t k, std::vector<std::pair<double, std::size_t>>& nearest){
+
+	nearest.clear();
+
+	// the search box would never cover the layer
+	if(!std::isfinite(x) || !std::isfinite(y)){
+		throw std::invalid_argument("the knn point must have finite coordinates");
+	}
+	if(!dataset.indexes.isBuilt(type)){
+		return false;
+	}
+	if(k == 0 || dataset.geometries.empty()){
+		return true;
+	}
+
+	const std::unique_ptr<geos::geom::Point> point = geos::geom::GeometryFactory::getDefaultInstance()->createPoint(geos::geom::CoordinateXY(x, y));
+
+	const double width = dataset.maxX - dataset.minX;
+	const double height = dataset.maxY - dataset.minY;
+
+	// beyond this half side the box holds the whole layer
+	const double reach = std::max({std::abs(x - dataset.minX), std::abs(x - dataset.maxX), std::abs(y - dataset.minY), std::abs(y - dataset.maxY)});
+
+	double half = std::sqrt(width * height * k / dataset.geometries.size()) / 2;
+	if(!(half > 0)){
+		half = std::max({width, height, reach, 1.0}) / 2;
+	}
+
+	while(true){
+
+		const geos::geom::Envelope box(x - half, x + half, y - half, y + half);
+
+		nearest.clear();
+		search_envelope(dataset, type, box, spatial::EnvelopePredicate::intersects, [&dataset, &point, &nearest](const std::size_t geomIdx){
+			nearest.emplace_back(dataset.geometries[geomIdx]->distance(point.get()), geomIdx);
+		});
+
+		const std::size_t found = std::min(k, nearest.size());
+		std::partial_sort(nearest.begin(), nearest.begin() + found, nearest.end());
+
+		if((found == k && nearest[k - 1].first <= half) || !(half < reach) || !std::isfinite(half)){
+			nearest.resize(found);
+			return true;
+		}
+
+		half *= 2;
+	}
+}
+
+// Collects at most limit results (all of them when limit is 0); the search
+// stops as soon as the limit is reached.
+bool search_limited(const spatial::Dataset& dataset, const std::string& type, const geos::geom::Envelope& envelope, const spatial::Predicate predicate, const std::size_t limit, std::vector<std::size_t>& geometriesFound){
+
+	if(limit == 0){
+		return search(dataset, type, envelope, predicate, geometriesFound);
+	}
+
+	geometriesFound.clear();
+
+	return search(dataset, type, envelope, predicate, [limit, &geometriesFound](const std::size_t geomIdx){
+		geometriesFound.push_back(geomIdx);
+		if(geometriesFound.size() == limit){
+			throw SearchStopped{};
+		}
+	});
+}
+
+// search() through the result cache of the dataset, when enabled. The cache
+// holds the candidates of the cells around the envelope; a hit refines them
+// against the envelope and the predicate without touching the index.
+bool cached_search(const spatial::Dataset& dataset, const std::string& type, const geos::geom::Envelope& envelope, const spatial::Predicate predicate, std::vector<std::size_t>& geometriesFound, bool* hit = nullptr){
+
+	if(hit){
+		*hit = false;
+	}
+	if(!dataset.resultCache.enabled()){
+		return search(dataset, type, envelope, predicate, geometriesFound);
+	}
+
+	const spatial::ResultCache::Key key = dataset.resultCache.key(type, envelope);
+	thread_local std::vector<std::size_t> candidates;
+
+	if(dataset.resultCache.lookup(key, candidates)){
+		if(hit){
+			*hit = true;
+		}
+	}else{
+		candidates.clear();
+		if(!search_envelope(dataset, type, dataset.resultCache.cellEnvelope(key), spatial::EnvelopePredicate::intersects, [](const std::size_t geomIdx){
+			candidates.push_back(geomIdx);
+		})){
+			return false;
+		}
+		dataset.resultCache.insert(key, candidates);
+	}
+
+	geometriesFound.clear();
+
+	if(predicate == spatial::Predicate::bbox){
+		spatial::ResultCache::refine(dataset.envelopeTable, spatial::EnvelopePredicate::contains, envelope, candidates, [&geometriesFound](const std::size_t geomIdx){
+			geometriesFound.push_back(geomIdx);
+		});
+		return true;
+	}
+
+	const spatial::QueryRegion region(envelope);
+	spatial::ResultCache::refine(dataset.envelopeTable, spatial::envelopeFilter(predicate), envelope, candidates, [&](const std::size_t geomIdx){
+		if(spatial::evaluate(predicate, region, geomIdx, *dataset.geometries[geomIdx], dataset.preparedCache.get())){
+			geometriesFound.push_back(geomIdx);
+		}
+	});
+	return true;
+}
+
+// The geometries within distance radius of (x, y).
+bool search_radius(const spatial::Dataset& dataset, const std::string& type, const double x, const double y, const double radius, std::vector<std::size_t>& geometriesFound){
+
+	geometriesFound.clear();
+
+	const std::unique_ptr<geos::geom::Point> point = geos::geom::GeometryFactory::getDefaultInstance()->createPoint(geos::geom::CoordinateXY(x, y));
+	const geos::geom::Envelope box(x - radius, x + radius, y - radius, y + radius);
+
+	return search_envelope(dataset, type, box, spatial::EnvelopePredicate::intersects, [&dataset, &point, radius, &geometriesFound](const std::size_t geomIdx){
+		if(dataset.geometries[geomIdx]->isWithinDistance(point.get(), radius)){
+			geometriesFound.push_back(geomIdx);
+		}
+	});
+}
+
+// Runs one query of a workload. The predicate applies to box queries; point
+// queries find the geometries intersecting the point.
+bool run_query(const spatial::Dataset& dataset, const std::string& type, const spatial::Query& query, const spatial::Predicate predicate, std::vector<std::size_t>& geometriesFound){
+
+	switch(query.kind){
+	case spatial::QueryKind::box:
+		return search(dataset, type, query.box, predicate, geometriesFound);
+	case spatial::QueryKind::point:
+		return search(dataset, type, query.box, spatial::Predicate::intersects, geometriesFound);
+	case spatial::QueryKind::radius:
+		return search_radius(dataset, type, query.x, query.y, query.radius, geometriesFound);
+	case spatial::QueryKind::knn:{
+		thread_local std::vector<std::pair<double, std::size_t>> nearest;
+		geometriesFound.clear();
+		if(!search_knn(dataset, type, query.x, query.y, query.k, nearest)){
+			return false;
+		}
+		for(const auto& [distance, geomIdx] : nearest){
+			geometriesFound.push_back(geomIdx);
+		}
+		return true;
+	}
+	}
+	return false;
+}
+
+// With exists only whether there is a result is printed; the search stops at
+// the first one.
+void search_range_report(std::ostream& out, const spatial::Dataset& dataset, const std::string& type, const geos::geom::Envelope& envelope, const spatial::Predicate predicate, std::size_t limit, const bool exists){
+
+	if(exists){
+		limit = 1;
+	}
+
+	std::vector<size_t> geometriesFound;
+	bool cached = false;
+
+	std::chrono::duration<double, std::milli> duration;
+	const auto start = std::chrono::steady_clock::now();
+	
+	const bool found = limit == 0 ? cached_search(dataset, type, envelope, predicate, geometriesFound, &cached) : search_limited(dataset, type, envelope, predicate, limit, geometriesFound);
+	if(!found){
+		out<<"Error: "<<type<<" not built yet"<<std::endl;
+		return;
+	}
+	
+	const auto end = std::chrono::steady_clock::now();
+	duration = end - start;
+
+	if(exists){
+		out<<"exists: "<<(geometriesFound.empty() ? "no" : "yes")<<std::endl;
+	}else{
+		out<<"geometries: "<<geometriesFound.size()<<(limit > 0 && geometriesFound.size() == limit ? " (limit reached)" : "")<<std::endl;
+	}
+	out<<"time: "<<time_to_string(duration.count())<<(cached ? " (cached)" : "")<<std::endl;
+}
+
+void cmd_search_range_xy(std::ostream& out, const std::string& type, const double x1, const double y1, const double x2, const double y2, const spatial::Predicate predicate, const std::string& datasetName, const std::size_t limit, const bool exists){
+
+	const std::shared_ptr<spatial::Dataset> dataset = find_dataset(out, datasetName);
+
+	if(!dataset){
+		return;
+	}
+	if(!isValidIndex(*dataset, type)){
+		out<<"Error: Invalid data structure type '"<<type<<"'"<<std::endl;
+		return;
+	}
+
+	search_range_report(out, *dataset, type, geos::geom::Envelope(x1, x2, y1, y2), predicate, limit, exists);
+}
+
+void cmd_search_range_random(std::ostream& out, const std::string& type, const spatial::Predicate predicate, const std::string& datasetName, const std::size_t limit, const bool exists){
+
+	const std::shared_ptr<spatial::Dataset> dataset = find_dataset(out, datasetName);
+
+	if(!dataset){
+		return;
+	}
+	if(!isValidIndex(*dataset, type)){
+		out<<"Error: Invalid data structure type '"<<type<<"'"<<std::endl;
+		return;
+	}
+
+    int idx = randInt(0, envelopeSize.size()-1);
+
+	double width = envelopeSize[idx].first;
+	double height = envelopeSize[idx].second;
+
+	geos::geom::Envelope envelope = create_random_envelope(dataset->minX, dataset->minY, dataset->maxX - width, dataset->maxY - height, width, height);
+
+	out<<"random envelope: "<<envelope.getMinX()<<", "<<envelope.getMinY()<<", "<<envelope.getMaxX()<<", "<<envelope.getMaxY()<<std::endl;
+
+	search_range_report(out, *dataset, type, envelope, predicate, limit, exists);
+}
+
+void cmd_compare_xy(std::ostream& out, const double x1, const double y1, const double x2, const double y2, const std::string& datasetName){
+
+	const std::shared_ptr<spatial::Dataset> dataset = find_dataset(out, datasetName);
+
+	if(!dataset){
+		return;
+	}
+
+    const std::vector<std::string> avaibleDataStructures = dataset->indexes.available();
+
+	for(const std::string& type : avaibleDataStructures){
+	
+		out<<std::string(20, '-')<<type<<std::string(20, '-')<<std::endl;
+
+		cmd_search_range_xy(out, type, x1, y1, x2, y2, spatial::Predicate::bbox, datasetName);
+
+		out<<std::string(40 + type.size(), '-')<<std::endl;
+	}
+}
+
+std::string latency_to_string(const spatial::LatencyHistogram& latencies){
+	std::ostringstream oss;
+	oss<<"p50 / p90 / p99 / p99.9 / max: ";
+	for(const double quantile : {0.5, 0.9, 0.99, 0.999}){
+		oss<<latencies.percentile(quantile) / 1000.0<<" / ";
+	}
+	oss<<latencies.max() / 1000.0<<" microseconds";
+	return oss.str();
+}
+
+struct CompareOptions{
+	std::size_t threads = 1;
+	spatial::Predicate predicate = spatial::Predicate::bbox;
+	std::ostream* histogramDump = nullptr;	// raw histograms of the serial runs
+	bool breakdown = false;			// time spent per phase, needs the phase timers
+	bool counters = false;			// hardware counters per query
+	std::size_t repeat = 1;			// serial runs of the queries per index
+	spatial::ReportWriter* report = nullptr;	// one record per run
+	std::string workload;			// workload description for the records
+	std::vector<std::string> indexes;	// the data structures to run, all the built ones when empty
+	bool verify = false;			// result sets checked against the linear scan
+};
+
+spatial::BenchRecord compare_record(const spatial::Dataset& dataset, const std::string& type, const CompareOptions& options, const std::size_t threads, const double milliseconds, const spatial::LatencyHistogram& latencies){
+
+	spatial::BenchRecord record;
+	record.command = "compare";
+	record.dataset = dataset.name;
+	record.index = type;
+	record.workload = options.workload;
+	record.threads = threads;
+	record.operations = latencies.count();
+	record.throughput = milliseconds > 0 ? latencies.count() / (milliseconds / 1000.0) : 0;
+	record.p50 = latencies.percentile(0.5);
+	record.p90 = latencies.percentile(0.9);
+	record.p99 = latencies.percentile(0.99);
+	record.p999 = latencies.percentile(0.999);
+	record.max = latencies.max();
+	record.memory = spatial::residentBytes();
+	return record;
+}
+
+std::string counters_to_string(const spatial::CounterValues& counters, const std::size_t queries){
+
+	std::ostringstream oss;
+	const char* separator = "";
+
+	for(std::size_t c = 0; c < spatial::COUNTERS; c++){
+		const spatial::Counter counter = static_cast<spatial::Counter>(c);
+		if(!counters.has(counter)){
+			continue;
+		}
+		oss<<separator<<spatial::counterName(counter)<<" "<<counters[counter] / queries;
+		separator = ", ";
+	}
+
+	if(counters.has(spatial::Counter::cycles) && counters.has(spatial::Counter::instructions) && counters[spatial::Counter::cycles] > 0){
+		oss<<separator<<"IPC "<<counters[spatial::Counter::instructions] / counters[spatial::Counter::cycles];
+	}
+	return oss.str();
+}
+
+std::string query_to_string(const spatial::Query& query){
+
+	std::ostringstream oss;
+	oss<<spatial::queryKindName(query.kind)<<" ";
+	switch(query.kind){
+	case spatial::QueryKind::radius:
+		oss<<query.x<<", "<<query.y<<" radius "<<query.radius;
+		break;
+	case spatial::QueryKind::knn:
+		oss<<query.x<<", "<<query.y<<" k "<<query.k;
+		break;
+	default:
+		oss<<query.box.getMinX()<<", "<<query.box.getMinY()<<", "<<query.box.getMaxX()<<", "<<query.box.getMaxY();
+	}
+	return oss.str();
+}
+
+// Runs the queries again, untimed, and compares every sorted result set with
+// the one of the linear scan; prints the first mismatches.
+void verify_queries(std::ostream& out, const spatial::Dataset& dataset, const std::string& type, const std::vector<spatial::Query>& queries, const spatial::Predicate predicate, const std::vector<std::vector<std::size_t>>& expected){
+
+	constexpr std::size_t MAX_PRINTED = 10;
+
+	std::vector<std::size_t> found;
+	std::vector<std::size_t> difference;
+	std::size_t mismatches = 0;
+	std::ostringstream details;
+
+	for(std::size_t i = 0; i < queries.size(); i++){
+
+		run_query(dataset, type, queries[i], predicate, found);
+		std::sort(found.begin(), found.end());
+
+		if(found == expected[i]){
+			continue;
+		}
+
+		if(++mismatches <= MAX_PRINTED){
+			difference.clear();
+			std::set_difference(expected[i].begin(), expected[i].end(), found.begin(), found.end(), std::back_inserter(difference));
+			const std::size_t missing = difference.size();
+			difference.clear();
+			std::set_difference(found.begin(), found.end(), expected[i].begin(), expected[i].end(), std::back_inserter(difference));
+
+			details<<"  query "<<i<<", "<<query_to_string(queries[i])<<": "<<found.size()<<" results, expected "<<expected[i].size()
+			<<" ("<<missing<<" missing, "<<difference.size()<<" extra)"<<std::endl;
+		}
+	}
+
+	if(mismatches == 0){
+		out<<"verify: all "<<queries.size()<<" queries match linear"<<std::endl;
+		return;
+	}
+
+	out<<"Error: verify: "<<mismatches<<" of "<<queries.size()<<" queries differ from linear"<<std::endl
+	<<details.str();
+	if(mismatches > MAX_PRINTED){
+		out<<"  ... "<<mismatches - MAX_PRINTED<<" more"<<std::endl;
+	}
+}
+
+// Runs the queries on every built data structure, serially (options.repeat
+// times) and then, with more than one thread, concurrently. Every query is
+// timed on its own.
+void compare_queries(std::ostream& out, const spatial::Dataset& dataset, const std::vector<spatial::Query>& queries, const CompareOptions& options){
+
+	const std::size_t threads = options.threads;
+	const spatial::Predicate predicate = options.predicate;
+
+    const std::vector<std::string> avaibleDataStructures = options.indexes.empty() ? dataset.indexes.available() : options.indexes;
+
+	for(const std::string& type : avaibleDataStructures){
+		if(!dataset.indexes.isBuilt(type)){
+			out<<"Error: "<<type<<" is not built"<<std::endl;
+			return;
+		}
+	}
+
+	const std::size_t iterations = queries.size();
+	const std::size_t executed = iterations * options.repeat;
+	std::vector<size_t> geometriesFound;
+	std::vector<size_t> resultCounts(iterations);
+
+	struct alignas(64) WorkerState{
+		std::vector<size_t> geometriesFound;
+		std::size_t queries = 0;
+		spatial::LatencyHistogram latencies;
+	};
+
+	// the reference results, before any timing
+	std::vector<std::vector<std::size_t>> expected;
+	if(options.verify){
+		expected.resize(iterations);
+		for(std::size_t i = 0; i < iterations; i++){
+			run_query(dataset, "linear", queries[i], predicate, expected[i]);
+			std::sort(expected[i].begin(), expected[i].end());
+		}
+	}
+
+	std::unique_ptr<spatial::ThreadPool> pool;
+	std::vector<WorkerState> workers;
+	if(threads > 1){
+		pool = std::make_unique<spatial::ThreadPool>(threads);
+		workers.resize(pool->size());
+	}
+
+	// the counters follow this thread, so they only cover the serial runs
+	std::unique_ptr<spatial::PerfCounters> counters;
+	if(options.counters){
+		counters = std::make_unique<spatial::PerfCounters>();
+		if(!counters->available()){
+			out<<"counters: disabled, "<<counters->error()<<std::endl;
+			counters.reset();
+		}
+	}
+
+	for(const std::string& type : avaibleDataStructures){
+	
+		out<<std::string(20, '-')<<type<<std::string(20, '-')<<std::endl;
+
+		std::size_t totalGeometriesFound = 0;
+		spatial::LatencyHistogram latencies;
+		const spatial::PhaseTotals phasesBefore = spatial::threadPhaseTotals();
+
+		if(counters){
+			counters->start();
+		}
+
+		std::chrono::duration<double, std::milli> duration{0};
+
+		// the geometries and candidates printed are those of the last run
+		for(std::size_t run = 0; run < options.repeat; run++){
+
+			spatial::LatencyHistogram runLatencies;
+			totalGeometriesFound = 0;
+			searchCandidates = 0;
+
+			const auto start = std::chrono::steady_clock::now();
+
+			for(size_t i=0; i<iterations; i++){
+
+				const auto queryStart = std::chrono::steady_clock::now();
+				run_query(dataset, type, queries[i], predicate, geometriesFound);
+				runLatencies.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - queryStart).count());
+
+				totalGeometriesFound += geometriesFound.size();
+				resultCounts[i] = geometriesFound.size();
+			}
+
+			const std::chrono::duration<double, std::milli> runDuration = std::chrono::steady_clock::now() - start;
+			duration += runDuration;
+			latencies.merge(runLatencies);
+
+			if(options.report){
+				options.report->write(compare_record(dataset, type, options, 1, runDuration.count(), runLatencies));
+			}
+		}
+
+		spatial::CounterValues counterValues;
+		if(counters){
+			counterValues = counters->stop();
+		}
+
+		out<<"geometries: "<<totalGeometriesFound<<std::endl
+		<<"candidates: "<<searchCandidates;
+		if(searchCandidates > 0){
+			out<<" ("<<100.0 * totalGeometriesFound / searchCandidates<<"% are results)";
+		}
+		out<<std::endl
+		<<"average time: "<<time_to_string(duration.count()/executed)<<std::endl
+		<<"total time: "<<time_to_string(duration.count())<<std::endl
+		<<"latency "<<latency_to_string(latencies)<<std::endl;
+
+		if(options.repeat > 1){
+			out<<"runs: "<<options.repeat<<std::endl;
+		}
+
+		if(counters && executed > 0){
+			out<<"per query: "<<counters_to_string(counterValues, executed)<<std::endl;
+		}
+
+		if(options.breakdown){
+			phase_breakdown(out, phasesBefore, spatial::threadPhaseTotals(), duration.count(), executed);
+		}
+
+		if(options.histogramDump){
+			*options.histogramDump<<"# "<<type<<": lower upper count, nanoseconds"<<std::endl;
+			latencies.dump(*options.histogramDump);
+		}
+
+		if(options.verify && type != "linear"){
+			verify_queries(out, dataset, type, queries, predicate, expected);
+		}
+
+		if(pool){
+
+			for(WorkerState& worker : workers){
+				worker.queries = 0;
+				worker.latencies.clear();
+			}
+			std::atomic<std::size_t> mismatches = 0;
+
+			std::chrono::duration<double, std::milli> parallelDuration;
+			const auto parallelStart = std::chrono::steady_clock::now();
+
+			pool->parallelFor(iterations, 16, [&](const std::size_t w, const std::size_t i){
+				WorkerState& worker = workers[w];
+				const auto queryStart = std::chrono::steady_clock::now();
+				run_query(dataset, type, queries[i], predicate, worker.geometriesFound);
+				worker.latencies.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - queryStart).count());
+				worker.queries++;
+				if(worker.geometriesFound.size() != resultCounts[i]){
+					mismatches++;
+				}
+			});
+
+			parallelDuration = std::chrono::steady_clock::now() - parallelStart;
+
+			const double serialQps = executed / (duration.count() / 1000.0);
+			const double parallelQps = iterations / (parallelDuration.count() / 1000.0);
+			const double speedup = parallelQps / serialQps;
+
+			out<<"threads: "<<pool->size()<<std::endl
+			<<"1 thread throughput: "<<serialQps<<" queries/second"<<std::endl
+			<<pool->size()<<" threads throughput: "<<parallelQps<<" queries/second"<<std::endl
+			<<"speedup: "<<speedup<<"x"<<std::endl
+			<<"scaling efficiency: "<<speedup / pool->size() * 100<<"%"<<std::endl
+			<<"queries per thread:";
+			spatial::LatencyHistogram parallelLatencies;
+			for(const WorkerState& worker : workers){
+				out<<" "<<worker.queries;
+				parallelLatencies.merge(worker.latencies);
+			}
+			out<<std::endl
+			<<pool->size()<<" threads latency "<<latency_to_string(parallelLatencies)<<std::endl;
+
+			if(options.report){
+				options.report->write(compare_record(dataset, type, options, pool->size(), parallelDuration.count(), parallelLatencies));
+			}
+
+			if(mismatches == 0){
+				out<<"concurrent reads: consistent with the serial run"<<std::endl;
+			}else{
+				out<<"concurrent reads: "<<mismatches<<" queries differ from the serial run"<<std::endl;
+			}
+		}
+
+		out<<std::string(40 + type.size(), '-')<<std::endl;
+	}
+}
+
+void cmd_compare_random(std::ostream& out, const std::size_t iterations, const std::size_t threads, const spatial::Predicate predicate, const std::string& datasetName){
+
+	const std::shared_ptr<spatial::Dataset> dataset = find_dataset(out, datasetName);
+
+	if(!dataset){
+		return;
+	}
+
+	const spatial::WorkloadSpec spec = default_workload_spec(defaultSeed);
+
+	out<<"workload: "<<spatial::describe(spec)<<std::endl;
+	CompareOptions options;
+	options.threads = threads;
+	options.predicate = predicate;
+
+	compare_queries(out, *dataset, create_workload(*dataset, spec, iterations), options);
+}
+
+spatial::Predicate predicate_option(const spatial::Options& options){
+
+	spatial::Predicate predicate = spatial::Predicate::bbox;
+	const std::string name = options.get<std::string>("predicate", "bbox");
+
+	if(!spatial::parsePredicate(name, predicate)){
+		throw std::invalid_argument("invalid predicate '" + name + "', expected bbox|intersects|contains|within");
+	}
+
+	return predicate;
+}
+
+void cmd_search_range(std::ostream& out, const std::vector<std::string>& args){
+
+	const spatial::Options options(args, {"predicate", "dataset", "limit"}, {"exists"});
+	const std::vector<std::string>& positional = options.positional();
+	const std::string datasetName = options.get<std::string>("dataset", "");
+
+	const bool exists = options.has("exists");
+	const std::size_t limit = options.get<std::size_t>("limit", 0);
+
+	if(exists && options.has("limit")){
+		out<<"Error: --exists and --limit cannot be used together"<<std::endl;
+	}else if(positional.size() == 1){
+		cmd_search_range_random(out, positional[0], predicate_option(options), datasetName, limit, exists);
+	}else if(positional.size() == 5){
+		cmd_search_range_xy(out, positional[0],
+			spatial::parseValue<double>("x1", positional[1]), spatial::parseValue<double>("y1", positional[2]),
+			spatial::parseValue<double>("x2", positional[3]), spatial::parseValue<double>("y2", positional[4]),
+			predicate_option(options), datasetName, limit, exists);
+	}else{
+		out<<"Error: expected search_range <type> [x1 y1 x2 y2] [--predicate P] [--limit N | --exists] [--dataset name]"<<std::endl;
+	}
+}
+
+// The options shaping a generated workload, shared by compare and workload.
+const std::set<std::string> workloadOptions{"seed", "distribution", "selectivity", "mix", "hotspots", "zipf", "k"};
+
+spatial::WorkloadSpec workload_spec_option(const spatial::Options& options){
+
+	spatial::WorkloadSpec spec = default_workload_spec(options.get<std::uint64_t>("seed", defaultSeed));
+
+	const std::string distribution = options.get<std::string>("distribution", "uniform");
+	if(!spatial::parseDistribution(distribution, spec.distribution)){
+		throw std::invalid_argument("invalid distribution '" + distribution + "', expected uniform|data|zipf");
+	}
+
+	spec.selectivity = options.get<double>("selectivity", 0);
+	if(spec.selectivity < 0 || spec.selectivity > 1){
+		throw std::invalid_argument("--selectivity must be between 0 and 1");
+	}
+
+	if(options.has("mix") && !spatial::parseMix(options.get<std::string>("mix", ""), spec.mix)){
+		throw std::invalid_argument("invalid mix '" + options.get<std::string>("mix", "") + "', expected e.g. box=70,point=10,radius=10,knn=10");
+	}
+
+	spec.hotspots = options.get<std::size_t>("hotspots", spec.hotspots);
+	spec.zipfExponent = options.get<double>("zipf", spec.zipfExponent);
+	spec.k = options.get<std::size_t>("k", spec.k);
+
+	return spec;
+}
+
+void cmd_compare(std::ostream& out, const std::vector<std::string>& args){
+
+	std::set<std::string> valueOptions{"threads", "predicate", "dataset", "workload", "save", "histogram", "report", "repeat", "indexes"};
+	valueOptions.insert(workloadOptions.begin(), workloadOptions.end());
+
+	const spatial::Options options(args, valueOptions, {"count", "breakdown", "counters", "verify"});
+	const std::vector<std::string>& positional = options.positional();
+	const std::string datasetName = options.get<std::string>("dataset", "");
+
+	std::ofstream histogramFile;
+	if(options.has("histogram")){
+		histogramFile.open(options.get<std::string>("histogram", ""));
+		if(!histogramFile){
+			out<<"Error: cannot write '"<<options.get<std::string>("histogram", "")<<"'"<<std::endl;
+			return;
+		}
+	}
+
+	CompareOptions compareOptions;
+	compareOptions.threads = options.get<std::size_t>("threads", 1);
+	compareOptions.predicate = predicate_option(options);
+	compareOptions.histogramDump = histogramFile.is_open() ? &histogramFile : nullptr;
+	compareOptions.breakdown = options.has("breakdown");
+	compareOptions.counters = options.has("counters");
+	compareOptions.verify = options.has("verify");
+	compareOptions.repeat = options.get<std::size_t>("repeat", 1);
+	std::istringstream indexesOption(options.get<std::string>("indexes", ""));
+	for(std::string type; std::getline(indexesOption, type, ','); ){
+		compareOptions.indexes.push_back(type);
+	}
+
+	if(compareOptions.repeat == 0){
+		out<<"Error: --repeat must be at least 1"<<std::endl;
+		return;
+	}
+
+	std::unique_ptr<spatial::ReportWriter> report;
+	if(options.has("report")){
+		report = std::make_unique<spatial::ReportWriter>(options.get<std::string>("report", ""));
+		if(!report->good()){
+			out<<"Error: cannot write '"<<options.get<std::string>("report", "")<<"'"<<std::endl;
+			return;
+		}
+		compareOptions.report = report.get();
+	}
+
+	if(compareOptions.breakdown && !spatial::PHASE_TIMERS){
+		out<<"Error: the phase timers are compiled out, configure with -DSPATIAL_PROFILE_PHASES=ON"<<std::endl;
+		return;
+	}
+
+	// replays a saved workload
+	if(options.has("workload")){
+
+		const std::shared_ptr<spatial::Dataset> dataset = find_dataset(out, datasetName);
+
+		if(!dataset){
+			return;
+		}
+		if(!positional.empty() || compareOptions.threads == 0){
+			out<<"Error: expected compare --workload file [--threads N] [--predicate P] [--dataset name]"<<std::endl;
+			return;
+		}
+
+		const std::string fileName = options.get<std::string>("workload", "");
+		std::ifstream file(fileName);
+		std::vector<spatial::Query> queries;
+		std::string error;
+
+		if(!file){
+			out<<"Error: cannot open '"<<fileName<<"'"<<std::endl;
+			return;
+		}
+		if(!spatial::loadWorkload(file, queries, error)){
+			out<<"Error: "<<fileName<<": "<<error<<std::endl;
+			return;
+		}
+
+		out<<"workload: "<<fileName<<", "<<queries.size()<<" queries"<<std::endl;
+		compareOptions.workload = "file=" + fileName + " queries=" + std::to_string(queries.size()) + " predicate=" + spatial::predicateName(compareOptions.predicate);
+		compare_queries(out, *dataset, queries, compareOptions);
+		return;
+	}
+
+	if(positional.size() == 4){
+		cmd_compare_xy(out,
+			spatial::parseValue<double>("x1", positional[0]), spatial::parseValue<double>("y1", positional[1]),
+			spatial::parseValue<double>("x2", positional[2]), spatial::parseValue<double>("y2", positional[3]),
+			datasetName);
+		return;
+	}
+	if(positional.size() != 1){
+		out<<"Error: expected compare <iterations> [--threads N] [--predicate P] [--count] [--breakdown] [--counters] [--verify] [--repeat N] [--report file] [--indexes a,b] [--dataset name] or compare x1 y1 x2 y2 [--dataset name]"<<std::endl;
+		return;
+	}
+
+	const std::size_t iterations = spatial::parseValue<std::size_t>("iterations", options.positional()[0]);
+	const spatial::WorkloadSpec spec = workload_spec_option(options);
+
+	if(options.has("count")){
+		cmd_compare_count(out, iterations, datasetName, spec);
+		return;
+	}
+
+	if(compareOptions.threads == 0){
+		out<<"Error: --threads must be at least 1"<<std::endl;
+		return;
+	}
+
+	const std::shared_ptr<spatial::Dataset> dataset = find_dataset(out, datasetName);
+
+	if(!dataset){
+		return;
+	}
+
+	const std::vector<spatial::Query> queries = create_workload(*dataset, spec, iterations);
+
+	if(options.has("save")){
+		std::ofstream file(options.get<std::string>("save", ""));
+		spatial::saveWorkload(file, spec, queries);
+		if(!file){
+			out<<"Error: cannot write '"<<options.get<std::string>("save", "")<<"'"<<std::endl;
+			return;
+		}
+	}
+
+	out<<"workload: "<<spatial::describe(spec)<<std::endl;
+	compareOptions.workload = spatial::describe(spec) + " queries=" + std::to_string(queries.size()) + " predicate=" + spatial::predicateName(compareOptions.predicate);
+	compare_queries(out, *dataset, queries, compareOptions);
+}
+
+// Generates a workload on the dataset and saves it, for compare --workload.
+void cmd_workload(std::ostream& out, const std::vector<std::string>& args){
+
+	std::set<std::string> valueOptions{"output", "dataset"};
+	valueOptions.insert(workloadOptions.begin(), workloadOptions.end());
+
+	const spatial::Options options(args, valueOptions);
+
+	if(options.positional().size() != 1 || !options.has("output")){
+		out<<"Error: expected workload <count> --output file [--seed S] [--distribution uniform|data|zipf] [--selectivity F] [--mix box=N,point=N,radius=N,knn=N] [--dataset name]"<<std::endl;
+		return;
+	}
+
+	const std::size_t count = spatial::parseValue<std::size_t>("count", options.positional()[0]);
+	const spatial::WorkloadSpec spec = workload_spec_option(options);
+	const std::shared_ptr<spatial::Dataset> dataset = find_dataset(out, options.get<std::string>("dataset", ""));
+
+	if(!dataset){
+		return;
+	}
+
+	const std::vector<spatial::Query> queries = create_workload(*dataset, spec, count);
+	const std::string fileName = options.get<std::string>("output", "");
+
+	std::ofstream file(fileName);
+	spatial::saveWorkload(file, spec, queries);
+	if(!file){
+		out<<"Error: cannot write '"<<fileName<<"'"<<std::endl;
+		return;
+	}
+
+	std::array<std::size_t, spatial::QUERY_KINDS> kinds{};
+	for(const spatial::Query& query : queries){
+		kinds[static_cast<std::size_t>(query.kind)]++;
+	}
+
+	out<<"workload: "<<spatial::describe(spec)<<std::endl
+	<<"queries:";
+	for(std::size_t kind = 0; kind < spatial::QUERY_KINDS; kind++){
+		out<<" "<<spatial::queryKindName(static_cast<spatial::QueryKind>(kind))<<" "<<kinds[kind];
+	}
+	out<<std::endl<<"saved to "<<fileName<<std::endl;
+}
+
+void cmd_seed(std::ostream& out, const std::uint64_t seed){
+
+	randomEngine.seed(seed);
+	out<<"random seed: "<<seed<<std::endl;
+}
+
+// Compares the benchmarks found in two reports and reports an error when one
+// got worse by more than the threshold and the run to run noise, so scripts
+// can stop on regressions.
+void cmd_bench_diff(std::ostream& out, const std::vector<std::string>& args){
+
+	const spatial::Options options(args, {"threshold"});
+	const std::vector<std::string>& positional = options.positional();
+
+	if(positional.size() != 2){
+		out<<"Error: expected bench-diff <baseline> <current> [--threshold percent]"<<std::endl;
+		return;
+	}
+
+	const double threshold = options.get<double>("threshold", 5) / 100.0;
+	std::vector<spatial::BenchRecord> reports[2];
+
+	for(std::size_t r = 0; r < 2; r++){
+		std::ifstream file(positional[r]);
+		std::string error;
+		if(!file){
+			out<<"Error: cannot open '"<<positional[r]<<"'"<<std::endl;
+			return;
+		}
+		if(!spatial::readReport(file, reports[r], error)){
+			out<<"Error: "<<positional[r]<<": "<<error<<std::endl;
+			return;
+		}
+	}
+
+	const std::vector<spatial::MetricDiff> diffs = spatial::diffReports(reports[0], reports[1], threshold);
+
+	if(diffs.empty()){
+		out<<"Error: the reports have no benchmark in common"<<std::endl;
+		return;
+	}
+
+	std::size_t regressions = 0;
+	std::string key;
+
+	for(const spatial::MetricDiff& diff : diffs){
+
+		if(diff.key != key){
+			key = diff.key;
+			out<<key<<" ("<<diff.baselineRuns<<" / "<<diff.currentRuns<<" runs)"<<std::endl;
+		}
+
+		out<<"  "<<diff.metric<<": "<<diff.baseline<<" -> "<<diff.current<<(diff.metric == "throughput" ? " operations/second" : " nanoseconds")
+		<<" ("<<(diff.change >= 0 ? "+" : "")<<diff.change * 100<<"%";
+		if(diff.noise > 0){
+			out<<", noise "<<diff.noise * 100<<"%";
+		}
+		out<<")";
+
+		if(diff.regression){
+			out<<" REGRESSION";
+			regressions++;
+		}else if(diff.improvement){
+			out<<" improvement";
+		}
+		out<<std::endl;
+	}
+
+	if(regressions > 0){
+		out<<"Error: "<<regressions<<" regressions beyond "<<threshold * 100<<"%"<<std::endl;
+	}else{
+		out<<"no regressions beyond "<<threshold * 100<<"%"<<std::endl;
+	}
+}
+
+// Counts and sums the attributes of the geometries whose envelope is inside
+// the rectangle. The aggregate r-tree takes the totals of the nodes inside the
+// rectangle; the other indexes collect the ids and add up their values.
+void cmd_count_range(std::ostream& out, const std::vector<std::string>& args){
+
+	const spatial::Options options(args, {"sum", "dataset"});
+	const std::vector<std::string>& positional = options.positional();
+
+	if(positional.size() != 1 && positional.size() != 5){
+		out<<"Error: expected count_range <type> [x1 y1 x2 y2] [--sum field,field] [--dataset name]"<<std::endl;
+		return;
+	}
+
+	const std::string& type = positional[0];
+
+	const std::shared_ptr<spatial::Dataset> dataset = find_dataset(out, options.get<std::string>("dataset", ""));
+
+	if(!dataset){
+		return;
+	}
+	if(!isValidIndex(*dataset, type)){
+		out<<"Error: Invalid data structure type '"<<type<<"'"<<std::endl;
+		return;
+	}
+
+	std::vector<std::size_t> fields;
+	std::istringstream sumOption(options.get<std::string>("sum", ""));
+	for(std::string name; std::getline(sumOption, name, ','); ){
+		const std::size_t field = dataset->attributes.find(name);
+		if(field == dataset->attributes.fieldCount()){
+			out<<"Error: no numeric field '"<<name<<"' in "<<dataset->name<<std::endl;
+			return;
+		}
+		fields.push_back(field);
+	}
+
+	geos::geom::Envelope envelope;
+	if(positional.size() == 5){
+		envelope = geos::geom::Envelope(
+			spatial::parseValue<double>("x1", positional[1]), spatial::parseValue<double>("x2", positional[3]),
+			spatial::parseValue<double>("y1", positional[2]), spatial::parseValue<double>("y2", positional[4]));
+	}else{
+		envelope = create_random_envelopes(*dataset, 1)[0];
+		out<<"random envelope: "<<envelope.getMinX()<<", "<<envelope.getMinY()<<", "<<envelope.getMaxX()<<", "<<envelope.getMaxY()<<std::endl;
+	}
+
+	spatial::Aggregate aggregate;
+	spatial::AggregateStats stats;
+
+	std::chrono::duration<double, std::milli> duration;
+	const auto start = std::chrono::steady_clock::now();
+
+	const std::shared_ptr<spatial::IndexSlot> slot = dataset->indexes.find(type);
+	const bool aggregateTree = slot && slot->type == "aggregate-r-tree";
+
+	if(aggregateTree){
+
+		const auto aggregateRTree = slot->aggregateRTree.load();
+		if(!aggregateRTree){
+			out<<"Error: "<<type<<" not built yet"<<std::endl;
+			return;
+		}
+		aggregate = aggregateRTree->aggregate(spatial::EnvelopePredicate::contains, envelope, &stats);
+
+	}else{
+
+		std::vector<std::size_t> geometriesFound;
+		if(!search(*dataset, type, envelope, geometriesFound)){
+			out<<"Error: "<<type<<" not built yet"<<std::endl;
+			return;
+		}
+
+		aggregate.count = geometriesFound.size();
+		aggregate.sums.assign(dataset->attributes.fieldCount(), 0.0);
+		for(const std::size_t field : fields){
+			for(const std::size_t geomIdx : geometriesFound){
+				aggregate.sums[field] += dataset->attributes.columns[field][geomIdx];
+			}
+		}
+	}
+
+	duration = std::chrono::steady_clock::now() - start;
+
+	out<<"geometries: "<<aggregate.count<<std::endl;
+	for(const std::size_t field : fields){
+		out<<"sum of "<<dataset->attributes.names[field]<<": "<<aggregate.sums[field]<<std::endl;
+	}
+	if(aggregateTree){
+		out<<"nodes visited: "<<stats.nodesVisited<<", taken whole: "<<stats.nodesCovered<<std::endl
+		<<"entries tested: "<<stats.entriesTested<<std::endl;
+	}
+	out<<"time: "<<time_to_string(duration.count())<<std::endl;
+}
+
+// Counts the geometries in random rectangles with every built index by
+// collecting their ids, and with the node totals of the aggregate r-tree.
+void cmd_compare_count(std::ostream& out, const std::size_t iterations, const std::string& datasetName, spatial::WorkloadSpec spec){
+
+	const std::shared_ptr<spatial::Dataset> dataset = find_dataset(out, datasetName);
+
+	if(!dataset){
+		return;
+	}
+
+	// counts are taken over boxes only
+	spec.mix = {0, 1, 0, 0};
+	out<<"workload: "<<spatial::describe(spec)<<std::endl;
+
+	std::vector<geos::geom::Envelope> envelopes;
+	for(const spatial::Query& query : create_workload(*dataset, spec, iterations)){
+		envelopes.push_back(query.box);
+	}
+	std::vector<size_t> geometriesFound;
+
+	// the first type is linear, which every other count is checked against
+	std::vector<size_t> expectedCounts(iterations);
+	bool first = true;
+
+	auto report = [&out, &expectedCounts, iterations](const std::vector<std::size_t>& counts, const double time){
+
+		const std::size_t mismatches = iterations - std::inner_product(counts.begin(), counts.end(), expectedCounts.begin(), std::size_t(0),
+			std::plus<>(), std::equal_to<>());
+
+		out<<"geometries: "<<std::accumulate(counts.begin(), counts.end(), std::size_t(0))<<std::endl
+		<<"average time: "<<time_to_string(time/iterations)<<std::endl
+		<<"total time: "<<time_to_string(time)<<std::endl
+		<<"counts: "<<(mismatches == 0 ? "consistent with linear" : std::to_string(mismatches) + " queries differ from linear")<<std::endl;
+	};
+
+	for(const std::string& type : dataset->indexes.available()){
+
+		out<<std::string(20, '-')<<type<<std::string(20, '-')<<std::endl;
+
+		std::vector<std::size_t> counts(iterations);
+		std::chrono::duration<double, std::milli> duration;
+		const auto start = std::chrono::steady_clock::now();
+
+		for(size_t i=0; i<iterations; i++){
+			search(*dataset, type, envelopes[i], geometriesFound);
+			counts[i] = geometriesFound.size();
+		}
+
+		duration = std::chrono::steady_clock::now() - start;
+
+		if(first){
+			expectedCounts = counts;
+			first = false;
+		}
+		out<<"counting ids"<<std::endl;
+		report(counts, duration.count());
+
+		const std::shared_ptr<spatial::IndexSlot> slot = dataset->indexes.find(type);
+
+		if(slot && slot->type == "aggregate-r-tree"){
+
+			const auto aggregateRTree = slot->aggregateRTree.load();
+			spatial::AggregateStats totals;
+
+			const auto aggregateStart = std::chrono::steady_clock::now();
+
+			for(size_t i=0; i<iterations; i++){
+				spatial::AggregateStats stats;
+				counts[i] = aggregateRTree->aggregate(spatial::EnvelopePredicate::contains, envelopes[i], &stats).count;
+				totals.nodesVisited += stats.nodesVisited;
+				totals.nodesCovered += stats.nodesCovered;
+				totals.entriesTested += stats.entriesTested;
+			}
+
+			duration = std::chrono::steady_clock::now() - aggregateStart;
+
+			out<<"node totals"<<std::endl;
+			report(counts, duration.count());
+			out<<"nodes visited per query: "<<static_cast<double>(totals.nodesVisited) / iterations<<", taken whole: "<<static_cast<double>(totals.nodesCovered) / iterations<<std::endl
+			<<"entries tested per query: "<<static_cast<double>(totals.entriesTested) / iterations<<std::endl;
+		}
+
+		out<<std::string(40 + type.size(), '-')<<std::endl;
+	}
+}
+
+void cmd_search_batch(std::ostream& out, const std::vector<std::string>& args){
+
+	const spatial::Options options(args, {"random", "threads", "predicate", "output", "dataset"});
+
+	if(options.positional().empty() || options.positional().size() > 2 || (options.positional().size() == 2) == options.has("random")){
+		out<<"Error: expected search_batch <type> <file> or search_batch <type> --random N"<<std::endl;
+		return;
+	}
+
+	const std::string& type = options.positional()[0];
+	const std::size_t threads = options.get<std::size_t>("threads", 1);
+	const spatial::Predicate predicate = predicate_option(options);
+
+	if(threads == 0){
+		out<<"Error: --threads must be at least 1"<<std::endl;
+		return;
+	}
+
+	const std::shared_ptr<spatial::Dataset> dataset = find_dataset(out, options.get<std::string>("dataset", ""));
+
+	if(!dataset){
+		return;
+	}
+	if(!isValidIndex(*dataset, type)){
+		out<<"Error: Invalid data structure type '"<<type<<"'"<<std::endl;
+		return;
+	}
+
+	std::vector<geos::geom::Envelope> envelopes;
+	if(options.has("random")){
+		envelopes = create_random_envelopes(*dataset, options.get<std::size_t>("random", 0));
+	}else if(!readEnvelopes(options.positional()[1], envelopes)){
+		out<<"Error: cannot read envelopes from '"<<options.positional()[1]<<"'"<<std::endl;
+		return;
+	}
+
+	if(envelopes.empty()){
+		out<<"Error: no envelopes to search"<<std::endl;
+		return;
+	}
+
+	spatial::ThreadPool pool(threads);
+	BatchResult result;
+
+	std::chrono::duration<double, std::milli> duration;
+	const auto start = std::chrono::steady_clock::now();
+
+	if(!search_batch(*dataset, type, envelopes, predicate, pool, result)){
+		out<<"Error: "<<type<<" not built yet"<<std::endl;
+		return;
+	}
+
+	duration = std::chrono::steady_clock::now() - start;
+
+	// the same queries one at a time, as compare runs them
+	std::vector<size_t> geometriesFound;
+	std::chrono::duration<double, std::milli> loopDuration;
+	const auto loopStart = std::chrono::steady_clock::now();
+
+	for(const geos::geom::Envelope& envelope : envelopes){
+		search(*dataset, type, envelope, predicate, geometriesFound);
+	}
+
+	loopDuration = std::chrono::steady_clock::now() - loopStart;
+
+	out<<"queries: "<<envelopes.size()<<std::endl
+	<<"geometries: "<<result.ids.size()<<std::endl
+	<<"batch time: "<<time_to_string(duration.count())<<" ("<<envelopes.size() / (duration.count() / 1000.0)<<" queries/second)"<<std::endl
+	<<"per-query loop time: "<<time_to_string(loopDuration.count())<<" ("<<envelopes.size() / (loopDuration.count() / 1000.0)<<" queries/second)"<<std::endl
+	<<"speedup: "<<loopDuration.count() / duration.count()<<"x"<<std::endl;
+
+	if(options.has("output")){
+
+		const std::string outputFile = options.get<std::string>("output", "");
+		std::ofstream output(outputFile);
+		if(!output){
+			out<<"Error: cannot write '"<<outputFile<<"'"<<std::endl;
+			return;
+		}
+
+		// one line per query: index, number of geometries, geometry ids
+		for(std::size_t q = 0; q < envelopes.size(); q++){
+			output<<q<<" "<<result.offsets[q + 1] - result.offsets[q];
+			for(std::size_t k = result.offsets[q]; k < result.offsets[q + 1]; k++){
+				output<<" "<<result.ids[k];
+			}
+			output<<"\n";
+		}
+	}
+}
+
+void cmd_search_polygon(std::ostream& out, const std::vector<std::string>& args){
+
+	const spatial::Options options(args, {"wkt", "file", "predicate", "dataset"});
+
+	if(options.positional().size() != 1 || options.has("wkt") == options.has("file")){
+		out<<"Error: expected search_polygon <type> --wkt \"POLYGON(...)\" or search_polygon <type> --file file.wkt"<<std::endl;
+		return;
+	}
+
+	const std::string& type = options.positional()[0];
+	const spatial::Predicate predicate = options.has("predicate") ? predicate_option(options) : spatial::Predicate::intersects;
+
+	const std::shared_ptr<spatial::Dataset> dataset = find_dataset(out, options.get<std::string>("dataset", ""));
+
+	if(!dataset){
+		return;
+	}
+	if(!isValidIndex(*dataset, type)){
+		out<<"Error: Invalid data structure type '"<<type<<"'"<<std::endl;
+		return;
+	}
+
+	std::string wkt = options.get<std::string>("wkt", "");
+	if(options.has("file")){
+		const std::string fileName = options.get<std::string>("file", "");
+		std::ifstream input(fileName);
+		if(!input){
+			out<<"Error: cannot read '"<<fileName<<"'"<<std::endl;
+			return;
+		}
+		wkt.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+	}
+
+	geos::io::WKTReader reader;
+	std::unique_ptr<geos::geom::Geometry> polygon = reader.read(wkt);
+
+	if(polygon->getGeometryTypeId() != geos::geom::GEOS_POLYGON && polygon->getGeometryTypeId() != geos::geom::GEOS_MULTIPOLYGON){
+		out<<"Error: expected a POLYGON or MULTIPOLYGON, got "<<polygon->getGeometryType()<<std::endl;
+		return;
+	}
+
+	const spatial::QueryRegion region(std::move(polygon));
+	std::vector<size_t> geometriesFound;
+	PolygonSearchStats stats;
+
+	std::chrono::duration<double, std::milli> duration;
+	const auto start = std::chrono::steady_clock::now();
+
+	if(!search_polygon(*dataset, type, region, predicate, [&geometriesFound](const std::size_t geomIdx){ geometriesFound.push_back(geomIdx); }, stats)){
+		out<<"Error: "<<type<<" not built yet"<<std::endl;
+		return;
+	}
+
+	duration = std::chrono::steady_clock::now() - start;
+
+	out<<"geometries: "<<geometriesFound.size()<<std::endl
+	<<"time: "<<time_to_string(duration.count())<<std::endl
+	<<"nodes inside / boundary / outside: "<<stats.nodesInside<<" / "<<stats.nodesBoundary<<" / "<<stats.nodesOutside<<std::endl
+	<<"accepted without refinement: "<<stats.accepted<<std::endl
+	<<"refined: "<<stats.refined<<std::endl;
+}
+
+void cmd_locate(std::ostream& out, const std::vector<std::string>& args){
+
+	const spatial::Options options(args, {"threads", "output", "dataset"});
+
+	if(options.positional().size() != 1){
+		out<<"Error: expected locate <file.shp|file.txt> [--threads N] [--output file]"<<std::endl;
+		return;
+	}
+
+	const std::size_t threads = options.get<std::size_t>("threads", 1);
+
+	if(threads == 0){
+		out<<"Error: --threads must be at least 1"<<std::endl;
+		return;
+	}
+
+	const std::shared_ptr<spatial::Dataset> dataset = find_dataset(out, options.get<std::string>("dataset", ""));
+
+	if(!dataset){
+		return;
+	}
+	if(!dataset->indexes.isBuilt("r-tree")){
+		out<<"Error: build the r-tree of the polygon layer first"<<std::endl;
+		return;
+	}
+
+	std::vector<geos::geom::CoordinateXY> points;
+	if(!readPoints(options.positional()[0], points)){
+		out<<"Error: cannot read points from '"<<options.positional()[0]<<"'"<<std::endl;
+		return;
+	}
+
+	spatial::ThreadPool pool(threads);
+	spatial::PolygonLayerLocator locator(dataset->geometries);
+	std::vector<std::int64_t> owners;
+
+	std::chrono::duration<double, std::milli> duration;
+	const auto start = std::chrono::steady_clock::now();
+
+	locate_points(*dataset, points, locator, pool, owners);
+
+	duration = std::chrono::steady_clock::now() - start;
+
+	const std::size_t located = std::count_if(owners.begin(), owners.end(), [](const std::int64_t owner){ return owner >= 0; });
+
+	out<<"points: "<<points.size()<<std::endl
+	<<"located: "<<located<<std::endl
+	<<"not located: "<<points.size() - located<<std::endl
+	<<"indexed polygons: "<<locator.indexedPolygons()<<std::endl
+	<<"time: "<<time_to_string(duration.count())<<" ("<<points.size() / (duration.count() / 1000.0)<<" points/second)"<<std::endl;
+
+	if(options.has("output")){
+
+		const std::string outputFile = options.get<std::string>("output", "");
+		std::ofstream output(outputFile);
+		if(!output){
+			out<<"Error: cannot write '"<<outputFile<<"'"<<std::endl;
+			return;
+		}
+
+		for(std::size_t p = 0; p < points.size(); p++){
+			output<<p<<" "<<owners[p]<<"\n";
+		}
+	}
+}
+
+// Joins a dataset with another dataset or with the layer of a shapefile: the
+// pairs (dataset feature, other feature) satisfying the predicate are counted
+// with the grid-partitioned join and with an index nested loop over the r-tree.
+void cmd_join(std::ostream& out, const std::vector<std::string>& args){
+
+	const spatial::Options options(args, {"predicate", "threads", "grid", "dataset"});
+
+	if(options.positional().size() != 1){
+		out<<"Error: expected join <file.shp|dataset> [--predicate P] [--threads N] [--grid N] [--dataset name]"<<std::endl;
+		return;
+	}
+
+	const spatial::Predicate predicate = options.has("predicate") ? predicate_option(options) : spatial::Predicate::intersects;
+	const std::size_t threads = options.get<std::size_t>("threads", 1);
+
+	if(threads == 0){
+		out<<"Error: --threads must be at least 1"<<std::endl;
+		return;
+	}
+
+	const std::shared_ptr<spatial::Dataset> dataset = find_dataset(out, options.get<std::string>("dataset", ""));
+
+	if(!dataset){
+		return;
+	}
+
+	// a loaded dataset, or a shapefile read for this join only
+	std::shared_ptr<spatial::Dataset> other = datasets.get(options.positional()[0]);
+
+	if(!other){
+		std::vector<std::shared_ptr<geos::geom::Geometry>> geometries;
+		if(!readShapeFile(options.positional()[0], geometries)){
+			out<<"Error: cannot read '"<<options.positional()[0]<<"'"<<std::endl;
+			return;
+		}
+		other = std::make_shared<spatial::Dataset>(options.positional()[0], std::move(geometries), preparedCacheCapacity);
+	}
+
+	const std::vector<std::shared_ptr<geos::geom::Geometry>>& others = other->geometries;
+	const std::vector<const geos::geom::Envelope*> otherEnvelopes = other->envelopes();
+
+	spatial::ThreadPool pool(threads);
+
+	auto refine = [predicate, &dataset, &others](const std::size_t geomIdx, const std::size_t otherIdx){
+		return spatial::evaluatePair(predicate, geomIdx, *dataset->geometries[geomIdx], *others[otherIdx], dataset->preparedCache.get());
+	};
+
+	const std::size_t gridSize = options.get<std::size_t>("grid", spatial::defaultJoinGridSize(dataset->geometries.size() + others.size(), pool.size()));
+	const spatial::JoinStats stats = spatial::gridJoin(dataset->envelopes(), otherEnvelopes, gridSize, pool, refine);
+	const double joinTime = stats.partitionTime + stats.filterTime + stats.refineTime;
+
+	out<<"predicate: "<<spatial::predicateName(predicate)<<std::endl
+	<<"geometries: "<<dataset->geometries.size()<<" x "<<others.size()<<std::endl
+	<<"grid: "<<stats.gridSize<<"x"<<stats.gridSize<<" ("<<stats.leftEntries + stats.rightEntries<<" entries, "
+	<<stats.leftEntries + stats.rightEntries - dataset->geometries.size() - others.size()<<" replicated)"<<std::endl
+	<<"candidate pairs: "<<stats.candidates<<std::endl
+	<<"pairs: "<<stats.pairs<<std::endl
+	<<"partition time: "<<time_to_string(stats.partitionTime)<<std::endl
+	<<"filter time: "<<time_to_string(stats.filterTime)<<std::endl
+	<<"refine time: "<<time_to_string(stats.refineTime)<<std::endl
+	<<"grid join time: "<<time_to_string(joinTime)<<std::endl;
+
+	const std::shared_ptr<spatial::IndexSlot> slot = dataset->indexes.find("r-tree");
+	const auto rTree = slot ? slot->rTree.load() : nullptr;
+	if(!rTree){
+		out<<"build the r-tree to compare with the index nested loop join"<<std::endl;
+		return;
+	}
+
+	// every other feature probes the r-tree of the loaded layer
+	std::vector<std::size_t> workerPairs(pool.size());
+
+	std::chrono::duration<double, std::milli> duration;
+	const auto start = std::chrono::steady_clock::now();
+
+	pool.parallelFor(others.size(), 64, [&](const std::size_t worker, const std::size_t otherIdx){
+
+		auto probe = [&](const std::size_t geomIdx){
+			if(dataset->geometries[geomIdx]->getEnvelopeInternal()->intersects(otherEnvelopes[otherIdx]) && refine(geomIdx, otherIdx)){
+				workerPairs[worker]++;
+			}
+		};
+
+		ItemVisitorAdapter<decltype(probe)> itemVisitor(probe);
+		rTree->query(otherEnvelopes[otherIdx], itemVisitor);
+	});
+
+	duration = std::chrono::steady_clock::now() - start;
+
+	const std::size_t pairs = std::accumulate(workerPairs.begin(), workerPairs.end(), std::size_t(0));
+
+	out<<"index nested loop join (r-tree): "<<pairs<<" pairs, "<<time_to_string(duration.count())
+	<<" (grid join speedup "<<duration.count() / joinTime<<"x)"<<std::endl;
+
+	if(pairs != stats.pairs){
+		out<<"Error: the index nested loop join found "<<pairs<<" pairs, the grid join "<<stats.pairs<<std::endl;
+	}
+}
+
+void cmd_knn(std::ostream& out, const std::vector<std::string>& args){
+
+	const spatial::Options options(args, {"dataset"});
+	const std::vector<std::string>& positional = options.positional();
+
+	if(positional.size() != 4){
+		out<<"Error: expected knn <type> <x> <y> <k> [--dataset name]"<<std::endl;
+		return;
+	}
+
+	const std::string& type = positional[0];
+	const double x = spatial::parseValue<double>("x", positional[1]);
+	const double y = spatial::parseValue<double>("y", positional[2]);
+	const std::size_t k = spatial::parseValue<std::size_t>("k", positional[3]);
+
+	const std::shared_ptr<spatial::Dataset> dataset = find_dataset(out, options.get<std::string>("dataset", ""));
+
+	if(!dataset){
+		return;
+	}
+	if(!isValidIndex(*dataset, type)){
+		out<<"Error: Invalid data structure type '"<<type<<"'"<<std::endl;
+		return;
+	}
+
+	std::vector<std::pair<double, std::size_t>> nearest;
+
+	std::chrono::duration<double, std::milli> duration;
+	const auto start = std::chrono::steady_clock::now();
+
+	if(!search_knn(*dataset, type, x, y, k, nearest)){
+		out<<"Error: "<<type<<" not built yet"<<std::endl;
+		return;
+	}
+
+	duration = std::chrono::steady_clock::now() - start;
+
+	for(const auto& [distance, geomIdx] : nearest){
+		out<<geomIdx<<" "<<distance<<std::endl;
+	}
+	out<<"geometries: "<<nearest.size()<<std::endl
+	<<"time: "<<time_to_string(duration.count())<<std::endl;
+}
+
+// The dataset named in a server request; the error becomes the response.
+std::shared_ptr<spatial::Dataset> request_dataset(const std::string& name){
+
+	std::shared_ptr<spatial::Dataset> dataset = datasets.get(name);
+
+	if(!dataset){
+		throw std::invalid_argument(name.empty() ? "no geometries loaded" : "no dataset named '" + name + "'");
+	}
+	return dataset;
+}
+
+std::string request_type(spatial::protocol::Reader& request){
+
+	std::string type = request.getString();
+
+	if(!isValidType(type)){
+		throw std::invalid_argument("invalid data structure type '" + type + "'");
+	}
+	return type;
+}
+
+// A type, or the name of an index of the dataset.
+std::string request_index(spatial::protocol::Reader& request, const spatial::Dataset& dataset){
+
+	std::string index = request.getString();
+
+	if(!isValidIndex(dataset, index)){
+		throw std::invalid_argument("no index '" + index + "' on " + dataset.name);
+	}
+	return index;
+}
+
+// Handles one request of the query server, on one of its query threads.
+std::string serve_request(const spatial::protocol::Opcode opcode, spatial::protocol::Reader& request){
+
+	namespace protocol = spatial::protocol;
+
+	protocol::Writer response;
+
+	switch(opcode){
+
+	case protocol::Opcode::load:{
+
+		const std::string file = request.getString();
+		const std::string name = request.getString();
+
+		std::ostringstream report;
+		// the clients keep querying the dataset it replaces meanwhile
+		if(name.empty() || !load_dataset(report, file, name, 1, false, true)){
+			throw std::invalid_argument("cannot load '" + file + "' as '" + name + "'");
+		}
+		response.put<std::uint64_t>(request_dataset(name)->geometries.size());
+		break;
+	}
+
+	case protocol::Opcode::build:{
+
+		const std::shared_ptr<spatial::Dataset> dataset = request_dataset(request.getString());
+		const std::string type = request_type(request);
+		const std::size_t threads = std::clamp<std::size_t>(request.get<std::uint32_t>(), 1, std::max(1u, std::thread::hardware_concurrency()));
+
+		spatial::BuildStats stats;
+		const auto start = std::chrono::steady_clock::now();
+
+		if(type == "linear" || !build(*dataset, type, type, {}, threads, stats)){
+			throw std::invalid_argument("cannot build " + type + " on " + dataset->name);
+		}
+		response.put(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		break;
+	}
+
+	case protocol::Opcode::search:{
+
+		const std::shared_ptr<spatial::Dataset> dataset = request_dataset(request.getString());
+		const std::string type = request_index(request, *dataset);
+		const std::uint8_t predicate = request.get<std::uint8_t>();
+		const double x1 = request.get<double>();
+		const double y1 = request.get<double>();
+		const double x2 = request.get<double>();
+		const double y2 = request.get<double>();
+
+		if(predicate > static_cast<std::uint8_t>(spatial::Predicate::within)){
+			throw std::invalid_argument("invalid predicate");
+		}
+
+		thread_local std::vector<std::size_t> geometriesFound;
+		if(!cached_search(*dataset, type, geos::geom::Envelope(x1, x2, y1, y2), static_cast<spatial::Predicate>(predicate), geometriesFound)){
+			throw std::invalid_argument(type + " not built yet");
+		}
+
+		response.put(static_cast<std::uint32_t>(geometriesFound.size()));
+		for(const std::size_t geomIdx : geometriesFound){
+			response.put(static_cast<std::uint32_t>(geomIdx));
+		}
+		break;
+	}
+
+	case protocol::Opcode::knn:{
+
+		const std::shared_ptr<spatial::Dataset> dataset = request_dataset(request.getString());
+		const std::string type = request_index(request, *dataset);
+		const double x = request.get<double>();
+		const double y = request.get<double>();
+		const std::uint32_t k = request.get<std::uint32_t>();
+
+		if(!std::isfinite(x) || !std::isfinite(y)){
+			throw std::invalid_argument("invalid knn point");
+		}
+
+		thread_local std::vector<std::pair<double, std::size_t>> nearest;
+		if(!search_knn(*dataset, type, x, y, k, nearest)){
+			throw std::invalid_argument(type + " not built yet");
+		}
+
+		response.put(static_cast<std::uint32_t>(nearest.size()));
+		for(const auto& [distance, geomIdx] : nearest){
+			response.put(static_cast<std::uint32_t>(geomIdx)).put(distance);
+		}
+		break;
+	}
+
+	case protocol::Opcode::info:{
+
+		const std::shared_ptr<spatial::Dataset> dataset = request_dataset(request.getString());
+
+		response.put<std::uint64_t>(dataset->geometries.size())
+		.put(dataset->minX).put(dataset->minY).put(dataset->maxX).put(dataset->maxY);
+		break;
+	}
+
+	default:
+		throw std::invalid_argument("unknown opcode " + std::to_string(static_cast<int>(opcode)));
+	}
+
+	return response.take();
+}
+
+// Serves the loaded datasets over a socket until SIGINT or SIGTERM.
+void cmd_serve(std::ostream& out, const std::vector<std::string>& args){
+
+	const spatial::Options options(args, {"unix", "port", "threads"});
+
+	if(!options.positional().empty() || options.has("unix") == options.has("port")){
+		out<<"Error: expected serve --unix path or serve --port N [--threads N]"<<std::endl;
+		return;
+	}
+
+	const std::size_t threads = options.get<std::size_t>("threads", std::max(1u, std::thread::hardware_concurrency()));
+
+	if(threads == 0){
+		out<<"Error: --threads must be at least 1"<<std::endl;
+		return;
+	}
+
+	spatial::QueryServer server(serve_request, threads);
+
+	if(options.has("unix")){
+		server.listenUnix(options.get<std::string>("unix", ""));
+		out<<"serving on "<<options.get<std::string>("unix", "");
+	}else{
+		server.listenTcp(options.get<std::uint16_t>("port", 0));
+		out<<"serving on 127.0.0.1:"<<options.get<std::uint16_t>("port", 0);
+	}
+	out<<" with "<<threads<<" query threads, ctrl-c to stop"<<std::endl;
+
+	struct sigaction action{};
+	struct sigaction previousInt{};
+	struct sigaction previousTerm{};
+	action.sa_handler = [](int){
+		if(spatial::QueryServer* server = runningServer.load()){
+			server->stop();
+		}
+	};
+	sigemptyset(&action.sa_mask);
+
+	runningServer = &server;
+	sigaction(SIGINT, &action, &previousInt);
+	sigaction(SIGTERM, &action, &previousTerm);
+
+	server.run();
+
+	sigaction(SIGINT, &previousInt, nullptr);
+	sigaction(SIGTERM, &previousTerm, nullptr);
+	runningServer = nullptr;
+
+	const spatial::QueryServer::Statistics stats = server.statistics();
+
+	out<<"connections: "<<stats.connections<<std::endl
+	<<"requests: "<<stats.requests<<" ("<<stats.errors<<" errors)"<<std::endl;
+}
+
+// Reads one envelope per line as "x1 y1 x2 y2"; empty lines and lines
+// starting with '#' are skipped.
+bool readEnvelopes(const std::string& fileName, std::vector<geos::geom::Envelope>& envelopes){
+
+	std::ifstream input(fileName);
+	if(!input){
+		return false;
+	}
+
+	envelopes.clear();
+	std::string line;
+
+	while(std::getline(input, line)){
+
+		if(line.empty() || line[0] == '#'){
+			continue;
+		}
+
+		std::istringstream iss(line);
+		double x1, y1, x2, y2;
+		if(!(iss >> x1 >> y1 >> x2 >> y2)){
+			return false;
+		}
+		envelopes.emplace_back(x1, x2, y1, y2);
+	}
+
+	return true;
+}
+
+// When attributes is given, the numeric fields of the DBF are read into it.
+bool readShapeFile(const std::string& fileName, std::vector<std::shared_ptr<geos::geom::Geometry>>& geometries, spatial::AttributeTable* attributes){
+
+    geometries.clear();
+
+    bpp::ShpReader reader;
+	std::string openError;
+    reader.setFile(fileName);
+    bool retval = reader.open(true, true, openError);
+
+	if(!retval){
+		return false;
+	}
+
+	std::vector<int> numericFields;
+	if(attributes){
+		*attributes = spatial::AttributeTable();
+		for(int i = 0; i < reader.getFieldCount(); i++){
+			const bpp::DataField& field = reader.getField(i);
+			if(field.type == bpp::fInt || field.type == bpp::fReal){
+				numericFields.push_back(i);
+				attributes->names.push_back(field.name);
+			}
+		}
+		attributes->columns.resize(numericFields.size());
+	}
+
+    geos::geom::Geometry* currGeom;
+
+    while(reader.next()){
+
+        switch(reader.getGeomType()){
+
+        case bpp::gPoint:
+            currGeom = reader.readPoint();
+            break;
+        case bpp::gMultiPoint:
+            currGeom = reader.readMultiPoint();
+            break;
+        case bpp::gLine:
+            currGeom = reader.readLineString();
+            break;
+        case bpp::gPolygon:
+            currGeom = reader.readMultiPolygon();
+			break;
+        case bpp::gUnknown:
+			std::cout << "[shpReader]: geometry unknow";
+            currGeom = nullptr;
+            break;
+        }
+
+        if(currGeom){
+            geometries.push_back(std::move(currGeom->clone()));
+
+			for(std::size_t f = 0; f < numericFields.size(); f++){
+				attributes->columns[f].push_back(reader.isNull(numericFields[f]) ? 0.0 : reader.toDouble(numericFields[f]));
+			}
+        }
+    }
+
+	return true;
+}
+
+// Reads the points of a point shapefile, or of a text file with one "x y"
+// pair per line.
+bool readPoints(const std::string& fileName, std::vector<geos::geom::CoordinateXY>& points){
+
+	points.clear();
+
+	if(fileName.ends_with(".shp")){
+
+		std::vector<std::shared_ptr<geos::geom::Geometry>> layer;
+		if(!readShapeFile(fileName, layer)){
+			return false;
+		}
+
+		for(const auto& geom : layer){
+			if(geom->getGeometryTypeId() != geos::geom::GEOS_POINT){
+				return false;
+			}
+			points.push_back(*std::static_pointer_cast<geos::geom::Point>(geom)->getCoordinate());
+		}
+		return true;
+	}
+
+	std::ifstream input(fileName);
+	if(!input){
+		return false;
+	}
+
+	std::string line;
+
+	while(std::getline(input, line)){
+
+		if(line.empty() || line[0] == '#'){
+			continue;
+		}
+
+		std::istringstream iss(line);
+		double x, y;
+		if(!(iss >> x >> y)){
+			return false;
+		}
+		points.emplace_back(x, y);
+	}
+
+	return true;
+}
@@ -0,0 +1,22 @@
+#ifndef COMMANDS_H_
+#define COMMANDS_H_
+
+#include <cli/cli.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+// The commands of demo (commands.cpp), shared by demo and spatial_bench.
+
+std::unique_ptr<cli::Menu> create_menu();
+
+// Runs the commands in order on a session writing to std::cout, stopping at
+// the first one that fails, then waits for the background tasks; returns 0
+// only if all of them succeeded.
+int run_commands(std::unique_ptr<cli::Menu> rootMenu, const std::vector<std::string>& commands);
+
+// Splits a command list on the semicolons outside double quotes; text after
+// an unquoted '#' is a comment.
+std::vector<std::string> split_commands(const std::string& text);
+
+#endif
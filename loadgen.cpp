@@ -0,0 +1,329 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include "utils/headers/options.h"
+#include "utils/headers/protocol.h"
+
+// Load generator for the query server of `demo serve`: opens a number of
+// connections, keeps a number of requests in flight on each one and reports
+// throughput and latency.
+
+using namespace spatial;
+
+struct Endpoint{
+	std::string unixPath;
+	std::uint16_t port = 0;
+};
+
+struct Response{
+	std::uint32_t id;
+	protocol::Status status;
+	std::string payload;
+};
+
+class Connection{
+public:
+	explicit Connection(const Endpoint& endpoint){
+
+		if(!endpoint.unixPath.empty()){
+			sockaddr_un address{};
+			address.sun_family = AF_UNIX;
+			endpoint.unixPath.copy(address.sun_path, sizeof(address.sun_path) - 1);
+			open(AF_UNIX, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+		}else{
+			sockaddr_in address{};
+			address.sin_family = AF_INET;
+			address.sin_port = htons(endpoint.port);
+			address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			open(AF_INET, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+
+			const int enable = 1;
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+		}
+	}
+
+	~Connection(){
+		::close(fd);
+	}
+
+	Connection(const Connection&) = delete;
+	Connection& operator=(const Connection&) = delete;
+
+	void send(protocol::Opcode opcode, std::uint32_t id, const std::string& payload){
+
+		const std::string frame = protocol::requestFrame(opcode, id, payload);
+
+		for(std::size_t sent = 0; sent < frame.size(); ){
+			const ssize_t n = ::send(fd, frame.data() + sent, frame.size() - sent, MSG_NOSIGNAL);
+			if(n < 0){
+				if(errno == EINTR){
+					continue;
+				}
+				throw std::system_error(errno, std::generic_category(), "send");
+			}
+			sent += n;
+		}
+	}
+
+	Response receive(){
+
+		std::string header(protocol::RESPONSE_HEADER_SIZE, '\0');
+		readExact(header.data(), header.size());
+
+		protocol::Reader reader(header);
+		const std::uint32_t size = reader.get<std::uint32_t>();
+
+		Response response;
+		response.id = reader.get<std::uint32_t>();
+		response.status = reader.get<protocol::Status>();
+		response.payload.resize(size - (protocol::RESPONSE_HEADER_SIZE - 4));
+		readExact(response.payload.data(), response.payload.size());
+
+		return response;
+	}
+
+	// Sends one request and waits for its response; throws on error responses.
+	std::string call(protocol::Opcode opcode, const std::string& payload){
+
+		send(opcode, 0, payload);
+		Response response = receive();
+
+		if(response.status != protocol::Status::ok){
+			protocol::Reader reader(response.payload);
+			throw std::runtime_error(reader.getString());
+		}
+		return std::move(response.payload);
+	}
+
+private:
+	void open(int family, const sockaddr* address, socklen_t size){
+
+		fd = socket(family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if(fd < 0 || connect(fd, address, size) < 0){
+			throw std::system_error(errno, std::generic_category(), "connect");
+		}
+	}
+
+	void readExact(char* data, std::size_t size){
+
+		for(std::size_t received = 0; received < size; ){
+			const ssize_t n = recv(fd, data + received, size - received, 0);
+			if(n == 0){
+				throw std::runtime_error("connection closed by the server");
+			}
+			if(n < 0){
+				if(errno == EINTR){
+					continue;
+				}
+				throw std::system_error(errno, std::generic_category(), "recv");
+			}
+			received += n;
+		}
+	}
+
+	int fd = -1;
+};
+
+struct Extent{
+	std::uint64_t geometries;
+	double minX, minY, maxX, maxY;
+};
+
+struct WorkerResult{
+	std::vector<double> latencies;	// microseconds
+	std::uint64_t errors = 0;
+	std::uint64_t results = 0;
+	std::string failure;
+};
+
+struct Workload{
+	Endpoint endpoint;
+	std::string dataset;
+	std::string type;
+	std::uint8_t predicate;
+	std::uint32_t knn;
+	std::size_t pipeline;
+	Extent extent;
+	double width;
+	double height;
+};
+
+// Sends count requests over one connection, keeping up to workload.pipeline
+// of them in flight.
+void runConnection(const Workload& workload, const std::size_t count, const std::uint64_t seed, WorkerResult& result){
+
+	std::mt19937_64 random(seed);
+	std::uniform_real_distribution<double> x(workload.extent.minX, std::max(workload.extent.minX, workload.extent.maxX - workload.width));
+	std::uniform_real_distribution<double> y(workload.extent.minY, std::max(workload.extent.minY, workload.extent.maxY - workload.height));
+
+	Connection connection(workload.endpoint);
+	std::vector<std::chrono::steady_clock::time_point> sentAt(count);
+	result.latencies.reserve(count);
+
+	std::size_t sent = 0;
+	std::size_t received = 0;
+
+	while(received < count){
+
+		while(sent < count && sent - received < workload.pipeline){
+
+			protocol::Writer request;
+			request.putString(workload.dataset).putString(workload.type);
+
+			const double x1 = x(random);
+			const double y1 = y(random);
+
+			if(workload.knn > 0){
+				request.put(x1).put(y1).put(workload.knn);
+			}else{
+				request.put(workload.predicate).put(x1).put(y1).put(x1 + workload.width).put(y1 + workload.height);
+			}
+
+			sentAt[sent] = std::chrono::steady_clock::now();
+			connection.send(workload.knn > 0 ? protocol::Opcode::knn : protocol::Opcode::search, static_cast<std::uint32_t>(sent), request.data());
+			sent++;
+		}
+
+		const Response response = connection.receive();
+		received++;
+
+		result.latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - sentAt[response.id]).count());
+
+		if(response.status != protocol::Status::ok){
+			result.errors++;
+		}else{
+			result.results += protocol::Reader(response.payload).get<std::uint32_t>();
+		}
+	}
+}
+
+int main(int argc, char* argv[]){
+
+	const std::vector<std::string> args(argv + 1, argv + argc);
+
+	try{
+		const Options options(args, {"unix", "port", "dataset", "type", "predicate", "requests", "connections", "pipeline", "knn", "size", "seed", "load", "threads"}, {"build"});
+
+		if(options.has("unix") == options.has("port")){
+			std::cerr<<"usage: loadgen (--unix path | --port N) [--dataset name] [--type r-tree] [--predicate bbox|intersects|contains|within]"<<std::endl
+			<<"               [--requests N] [--connections N] [--pipeline N] [--size fraction] [--knn K] [--seed S]"<<std::endl
+			<<"               [--load file.shp] [--build] [--threads N]"<<std::endl;
+			return 2;
+		}
+
+		Endpoint endpoint;
+		endpoint.unixPath = options.get<std::string>("unix", "");
+		endpoint.port = options.get<std::uint16_t>("port", 0);
+
+		const std::string dataset = options.get<std::string>("dataset", "");
+		const std::string type = options.get<std::string>("type", "r-tree");
+		const std::string predicateName = options.get<std::string>("predicate", "bbox");
+		const std::size_t requests = options.get<std::size_t>("requests", 100000);
+		const std::size_t connectionCount = std::max<std::size_t>(options.get<std::size_t>("connections", 1), 1);
+		const std::size_t pipeline = std::max<std::size_t>(options.get<std::size_t>("pipeline", 1), 1);
+		const std::uint32_t knn = options.get<std::uint32_t>("knn", 0);
+		const double size = options.get<double>("size", 0.01);
+		const std::uint64_t seed = options.get<std::uint64_t>("seed", 42);
+
+		// same order as spatial::Predicate
+		const std::vector<std::string> predicates{"bbox", "intersects", "contains", "within"};
+		const auto predicate = std::find(predicates.begin(), predicates.end(), predicateName);
+		if(predicate == predicates.end()){
+			throw std::invalid_argument("invalid predicate '" + predicateName + "'");
+		}
+
+		Connection control(endpoint);
+
+		if(options.has("load")){
+			const std::string response = control.call(protocol::Opcode::load,
+				protocol::Writer().putString(options.get<std::string>("load", "")).putString(dataset.empty() ? "default" : dataset).take());
+			protocol::Reader reader(response);
+			std::cout<<"loaded "<<reader.get<std::uint64_t>()<<" geometries"<<std::endl;
+		}
+		if(options.has("build")){
+			const std::string response = control.call(protocol::Opcode::build,
+				protocol::Writer().putString(dataset).putString(type).put(options.get<std::uint32_t>("threads", 1)).take());
+			protocol::Reader reader(response);
+			std::cout<<"built "<<type<<" in "<<reader.get<double>()<<" milliseconds"<<std::endl;
+		}
+
+		const std::string infoResponse = control.call(protocol::Opcode::info, protocol::Writer().putString(dataset).take());
+		protocol::Reader info(infoResponse);
+		const Extent extent{info.get<std::uint64_t>(), info.get<double>(), info.get<double>(), info.get<double>(), info.get<double>()};
+
+		std::cout<<"geometries: "<<extent.geometries<<std::endl;
+
+		const double width = (extent.maxX - extent.minX) * size;
+		const double height = (extent.maxY - extent.minY) * size;
+
+		const Workload workload{endpoint, dataset, type, static_cast<std::uint8_t>(predicate - predicates.begin()), knn, pipeline, extent, width, height};
+
+		std::vector<WorkerResult> results(connectionCount);
+		std::vector<std::thread> threads;
+
+		const auto start = std::chrono::steady_clock::now();
+
+		for(std::size_t c = 0; c < connectionCount; c++){
+
+			threads.emplace_back([&, c](){
+
+				const std::size_t count = requests / connectionCount + (c < requests % connectionCount ? 1 : 0);
+				try{
+					runConnection(workload, count, seed + c, results[c]);
+				}catch(const std::exception& e){
+					results[c].failure = e.what();
+				}
+			});
+		}
+
+		for(std::thread& thread : threads){
+			thread.join();
+		}
+
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::vector<double> latencies;
+		std::uint64_t errors = 0;
+		std::uint64_t found = 0;
+		for(WorkerResult& result : results){
+			if(!result.failure.empty()){
+				std::cerr<<"Error: "<<result.failure<<std::endl;
+			}
+			latencies.insert(latencies.end(), result.latencies.begin(), result.latencies.end());
+			errors += result.errors;
+			found += result.results;
+		}
+		std::sort(latencies.begin(), latencies.end());
+
+		auto percentile = [&latencies](const double p){
+			return latencies.empty() ? 0.0 : latencies[std::min(latencies.size() - 1, static_cast<std::size_t>(p * latencies.size()))];
+		};
+
+		std::cout<<"requests: "<<latencies.size()<<" ("<<errors<<" errors)"<<std::endl
+		<<"results: "<<found<<std::endl
+		<<"connections: "<<connectionCount<<", pipeline: "<<pipeline<<std::endl
+		<<"time: "<<seconds<<" seconds"<<std::endl
+		<<"throughput: "<<latencies.size() / seconds<<" requests/second"<<std::endl
+		<<"latency p50 / p90 / p99 / max: "<<percentile(0.5)<<" / "<<percentile(0.9)<<" / "<<percentile(0.99)<<" / "
+		<<(latencies.empty() ? 0.0 : latencies.back())<<" microseconds"<<std::endl;
+
+	}catch(const std::exception& e){
+		std::cerr<<"Error: "<<e.what()<<std::endl;
+		return 1;
+	}
+
+	return 0;
+}
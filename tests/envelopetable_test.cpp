@@ -0,0 +1,131 @@
+#include <geos/geom/Envelope.h>
+#include <geos/geom/GeometryFactory.h>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "utils/headers/envelopetable.h"
+
+// The selections of the envelope table kernel, the widest one of the cpu or
+// the one named by SPATIAL_KERNEL, against a plain test of every feature, over
+// counts and offsets that leave tails shorter than a vector.
+
+namespace {
+
+	int failures = 0;
+
+	void check(const bool condition, const std::string& what){
+		if(!condition){
+			std::cerr<<"FAIL: "<<what<<std::endl;
+			failures++;
+		}
+	}
+
+	// the predicates as the scalar path evaluates them: a null envelope never matches
+	bool expected(const spatial::EnvelopePredicate predicate, const geos::geom::Envelope& feature, const geos::geom::Envelope& query){
+
+		if(feature.isNull() || query.isNull()){
+			return false;
+		}
+		if(predicate == spatial::EnvelopePredicate::contains){
+			return feature.getMinX() >= query.getMinX() && feature.getMaxX() <= query.getMaxX()
+				&& feature.getMinY() >= query.getMinY() && feature.getMaxY() <= query.getMaxY();
+		}
+		return feature.getMinX() <= query.getMaxX() && feature.getMaxX() >= query.getMinX()
+			&& feature.getMinY() <= query.getMaxY() && feature.getMaxY() >= query.getMinY();
+	}
+
+	std::string describe(const spatial::EnvelopePredicate predicate, const std::size_t q, const std::size_t begin, const std::size_t count){
+		return std::string(predicate == spatial::EnvelopePredicate::contains ? "contains" : "intersects")
+			+ ", query " + std::to_string(q) + ", begin " + std::to_string(begin) + ", count " + std::to_string(count);
+	}
+}
+
+int main(){
+
+	const char* requested = std::getenv("SPATIAL_KERNEL");
+	if(requested && *requested && std::string(requested) != spatial::EnvelopeTable::kernelName()){
+		std::cout<<"envelopetable: no "<<requested<<" kernel on this cpu, skipped"<<std::endl;
+		return 77;
+	}
+
+	// small integer coordinates, so that features often touch the queries
+	std::mt19937_64 engine(7);
+	std::uniform_int_distribution<int> coordinate(0, 20);
+	auto randomEnvelope = [&engine, &coordinate](){
+		return geos::geom::Envelope(coordinate(engine), coordinate(engine), coordinate(engine), coordinate(engine));
+	};
+
+	const geos::geom::GeometryFactory* factory = geos::geom::GeometryFactory::getDefaultInstance();
+	std::vector<std::shared_ptr<geos::geom::Geometry>> geometries;
+	std::vector<geos::geom::Envelope> envelopes;
+
+	for(std::size_t i = 0; i < 300; i++){
+		// a missing geometry has a null envelope
+		if(i % 17 == 5){
+			geometries.push_back(nullptr);
+			envelopes.emplace_back();
+			continue;
+		}
+		const geos::geom::Envelope envelope = randomEnvelope();
+		geometries.push_back(factory->toGeometry(&envelope));
+		envelopes.push_back(envelope);
+	}
+
+	spatial::EnvelopeTable table;
+	table.build(geometries);
+
+	std::vector<geos::geom::Envelope> queries{geos::geom::Envelope()};
+	for(std::size_t q = 0; q < 20; q++){
+		queries.push_back(randomEnvelope());
+	}
+
+	std::uniform_int_distribution<std::size_t> feature(0, geometries.size() - 1);
+
+	for(const spatial::EnvelopePredicate predicate : {spatial::EnvelopePredicate::contains, spatial::EnvelopePredicate::intersects}){
+		for(std::size_t q = 0; q < queries.size(); q++){
+
+			// ranges, the bits past the count included
+			for(const std::size_t begin : {0, 1, 3, 7, 63}){
+				for(std::size_t count = 0; count <= 140; count++){
+
+					std::vector<std::uint64_t> selection((count + 63) / 64, ~std::uint64_t(0));
+					table.select(predicate, queries[q], begin, count, selection.data());
+
+					bool same = true;
+					for(std::size_t i = 0; i < selection.size() * 64; i++){
+						const bool selected = (selection[i / 64] >> (i % 64)) & 1;
+						same = same && selected == (i < count && expected(predicate, envelopes[begin + i], queries[q]));
+					}
+					check(same, "range " + describe(predicate, q, begin, count));
+				}
+			}
+
+			// ids gathered from anywhere in the table
+			for(std::size_t count = 0; count <= 64; count++){
+
+				std::vector<std::size_t> ids(count);
+				for(std::size_t& id : ids){
+					id = feature(engine);
+				}
+
+				const std::uint64_t selection = table.select(predicate, queries[q], ids.data(), count);
+
+				bool same = true;
+				for(std::size_t j = 0; j < 64; j++){
+					const bool selected = (selection >> j) & 1;
+					same = same && selected == (j < count && expected(predicate, envelopes[ids[j]], queries[q]));
+				}
+				check(same, "ids " + describe(predicate, q, 0, count));
+			}
+		}
+	}
+
+	if(failures == 0){
+		std::cout<<"envelopetable ("<<spatial::EnvelopeTable::kernelName()<<"): ok"<<std::endl;
+	}
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+#include <geos/geom/GeometryFactory.h>
+#include <geos/geom/Point.h>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "utils/headers/resultcache.h"
+
+// Two envelopes falling in the same cells share a cache entry, but each must
+// still get its own answer.
+
+namespace {
+
+	int failures = 0;
+
+	void check(const bool condition, const std::string& what){
+		if(!condition){
+			std::cerr<<"FAIL: "<<what<<std::endl;
+			failures++;
+		}
+	}
+
+	// the bbox search of cached_search, with a linear scan for the index
+	std::vector<std::size_t> search(spatial::ResultCache& cache, const spatial::EnvelopeTable& table, const geos::geom::Envelope& query, bool& hit){
+
+		const spatial::ResultCache::Key key = cache.key("linear", query);
+		std::vector<std::size_t> candidates;
+
+		hit = cache.lookup(key, candidates);
+		if(!hit){
+			table.scan(spatial::EnvelopePredicate::intersects, cache.cellEnvelope(key), [&candidates](const std::size_t id){
+				candidates.push_back(id);
+			});
+			cache.insert(key, candidates);
+		}
+
+		std::vector<std::size_t> results;
+		spatial::ResultCache::refine(table, spatial::EnvelopePredicate::contains, query, candidates, [&results](const std::size_t id){
+			results.push_back(id);
+		});
+		return results;
+	}
+}
+
+int main(){
+
+	const geos::geom::GeometryFactory* factory = geos::geom::GeometryFactory::getDefaultInstance();
+	const std::vector<std::shared_ptr<geos::geom::Geometry>> points{
+		factory->createPoint(geos::geom::CoordinateXY(0.5, 0.5)),
+		factory->createPoint(geos::geom::CoordinateXY(1.4, 1.4)),
+		factory->createPoint(geos::geom::CoordinateXY(3, 3))
+	};
+
+	spatial::EnvelopeTable table;
+	table.build(points);
+
+	spatial::ResultCache cache;
+	cache.configure(1 << 20, 1.0);
+
+	const geos::geom::Envelope small(0, 1.2, 0, 1.2);
+	const geos::geom::Envelope large(0.1, 1.6, 0.1, 1.6);
+
+	check(cache.key("linear", small) == cache.key("linear", large), "the envelopes share a key");
+
+	bool hit;
+	check(search(cache, table, small, hit) == std::vector<std::size_t>{0}, "small envelope, miss");
+	check(!hit, "first search misses");
+
+	check(search(cache, table, large, hit) == std::vector<std::size_t>{0, 1}, "large envelope, hit");
+	check(hit, "second search hits");
+
+	check(search(cache, table, small, hit) == std::vector<std::size_t>{0}, "small envelope, hit");
+	check(hit, "third search hits");
+
+	// rebuilding another index leaves the entry alone
+	cache.invalidate("r-tree");
+	check(cache.statistics().entries == 1, "invalidation of another index keeps the entry");
+	cache.invalidate("linear");
+	check(cache.statistics().entries == 0, "invalidation of the index drops the entry");
+
+	if(failures == 0){
+		std::cout<<"resultcache: ok"<<std::endl;
+	}
+	return failures == 0 ? 0 : 1;
+}
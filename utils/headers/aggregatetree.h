@@ -0,0 +1,117 @@
+#ifndef AGGREGATETREE_H_
+#define AGGREGATETREE_H_
+
+#include <geos/geom/Envelope.h>
+#include <cstdint>
+#include <vector>
+#include "attributes.h"
+#include "envelopetable.h"
+
+namespace spatial {
+
+	struct Aggregate{
+		std::size_t count = 0;
+		std::vector<double> sums;	// one per field of the attribute table
+	};
+
+	struct IndexStats;
+
+	struct AggregateStats{
+		std::size_t nodesVisited = 0;
+		std::size_t nodesCovered = 0;	// inside the query, taken from the node totals
+		std::size_t entriesTested = 0;
+	};
+
+	// An STR-packed R-tree whose nodes also store the number of features below
+	// them and the sum of every numeric field over those features. A count or
+	// sum query takes the totals of the nodes lying inside the query envelope
+	// without descending into them, so its cost depends on the boundary of the
+	// query rather than on the number of features it covers.
+	class AggregateRTree{
+	public:
+		constexpr static std::size_t NODE_CAPACITY = 16;
+
+		// Features with an empty envelope are left out.
+		void build(const std::vector<const geos::geom::Envelope*>& envelopes, const AttributeTable& attributes);
+
+		// Count and sums over the features whose envelope passes the predicate
+		// against the query envelope.
+		Aggregate aggregate(EnvelopePredicate predicate, const geos::geom::Envelope& query, AggregateStats* stats = nullptr) const;
+
+		// Calls visitor(id) for every feature whose envelope intersects the query.
+		template<typename Visitor>
+		void query(const geos::geom::Envelope& query, Visitor&& visitor) const;
+
+		std::size_t size() const{
+			return entryIds.size();
+		}
+
+		std::size_t nodeCount() const{
+			return nodes.size();
+		}
+
+		std::size_t fieldCount() const{
+			return fields;
+		}
+
+		// memory accounting of the stats command
+		friend IndexStats aggregateTreeStats(const AggregateRTree& tree);
+
+	private:
+		struct Node{
+			geos::geom::Envelope envelope;
+			std::uint32_t begin;	// entries of a leaf, children of an inner node
+			std::uint32_t end;
+			bool leaf;
+		};
+
+		const double* nodeSums(const std::size_t node) const{
+			return sums.data() + node * fields;
+		}
+
+		// the root is the last node
+		std::vector<Node> nodes;
+		std::vector<std::size_t> counts;
+		std::vector<double> sums;
+
+		// features in leaf order, with their field values copied alongside
+		std::vector<geos::geom::Envelope> entryEnvelopes;
+		std::vector<std::size_t> entryIds;
+		std::vector<double> entryValues;
+
+		std::size_t fields = 0;
+	};
+
+	template<typename Visitor>
+	void AggregateRTree::query(const geos::geom::Envelope& query, Visitor&& visitor) const{
+
+		if(nodes.empty()){
+			return;
+		}
+
+		std::vector<std::uint32_t> stack{static_cast<std::uint32_t>(nodes.size() - 1)};
+
+		while(!stack.empty()){
+
+			const Node& node = nodes[stack.back()];
+			stack.pop_back();
+
+			if(!node.envelope.intersects(query)){
+				continue;
+			}
+			if(node.leaf){
+				for(std::uint32_t e = node.begin; e < node.end; e++){
+					if(entryEnvelopes[e].intersects(query)){
+						visitor(entryIds[e]);
+					}
+				}
+			}else{
+				for(std::uint32_t child = node.begin; child < node.end; child++){
+					stack.push_back(child);
+				}
+			}
+		}
+	}
+}
+
+#endif
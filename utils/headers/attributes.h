@@ -0,0 +1,27 @@
+#ifndef ATTRIBUTES_H_
+#define ATTRIBUTES_H_
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace spatial {
+
+	// The numeric DBF fields of a layer, one column per field with one value
+	// per geometry. Null values are stored as 0 so that they do not change sums.
+	struct AttributeTable{
+		std::vector<std::string> names;
+		std::vector<std::vector<double>> columns;
+
+		std::size_t fieldCount() const{
+			return names.size();
+		}
+
+		// index of the field, or fieldCount() when there is none with that name
+		std::size_t find(const std::string& name) const{
+			return std::find(names.begin(), names.end(), name) - names.begin();
+		}
+	};
+}
+
+#endif
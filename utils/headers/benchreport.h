@@ -0,0 +1,85 @@
+#ifndef BENCHREPORT_H_
+#define BENCHREPORT_H_
+
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace spatial {
+
+	// One run of one index, as written by `compare --report` and
+	// `build --report`. The units are fixed whatever the magnitude.
+	struct BenchRecord{
+		std::string command;		// compare or build
+		std::string dataset;
+		std::string index;
+		std::string workload;
+		std::size_t threads = 1;
+		std::uint64_t operations = 0;	// queries, or geometries indexed
+		double throughput = 0;			// operations/second
+		double p50 = 0;					// latencies in nanoseconds
+		double p90 = 0;
+		double p99 = 0;
+		double p999 = 0;
+		double max = 0;
+		std::uint64_t memory = 0;		// resident bytes, for builds the peak growth during the build
+
+		// What identifies the benchmark; records with the same key are
+		// repeated runs of it.
+		std::string key() const;
+	};
+
+	// Resident set size of the process in bytes, 0 when unknown.
+	std::uint64_t residentBytes();
+
+	// Peak resident set size since the start of the process or the last
+	// resetPeakResident(), 0 when unknown. The reset needs Linux 4.0.
+	std::uint64_t peakResidentBytes();
+	void resetPeakResident();
+
+	// Appends records to a file: CSV with a header line when the name ends
+	// in .csv, otherwise JSON with one object per line.
+	class ReportWriter{
+	public:
+		explicit ReportWriter(const std::string& fileName);
+
+		bool good() const{
+			return file.good();
+		}
+
+		void write(const BenchRecord& record);
+
+	private:
+		std::ofstream file;
+		bool csv;
+		bool headerWritten;
+	};
+
+	// Reads a file written by ReportWriter, in either format.
+	bool readReport(std::istream& in, std::vector<BenchRecord>& records, std::string& error);
+
+	// Comparison of one metric of one benchmark between two reports. Each
+	// side is the mean of its repeated runs; the noise is twice the standard
+	// error of the difference of the means, relative to the baseline, and
+	// is 0 with a single run on each side.
+	struct MetricDiff{
+		std::string key;
+		std::string metric;
+		double baseline;
+		double current;
+		double change;		// relative, positive when current is larger
+		double noise;
+		std::size_t baselineRuns;
+		std::size_t currentRuns;
+		bool regression;	// worse by more than the threshold and the noise
+		bool improvement;
+	};
+
+	// Compares throughput, p50 and p99 of the benchmarks found in both
+	// reports. threshold is relative, 0.05 for 5%.
+	std::vector<MetricDiff> diffReports(const std::vector<BenchRecord>& baseline, const std::vector<BenchRecord>& current, double threshold);
+}
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef DATASET_H_
+#define DATASET_H_
+
+#include <geos/geom/Envelope.h>
+#include <geos/geom/Geometry.h>
+#include <geos/index/kdtree/KdTree.h>
+#include <geos/index/quadtree/Quadtree.h>
+#include <geos/index/strtree/STRtree.h>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "aggregatetree.h"
+#include "attributes.h"
+#include "envelopetable.h"
+#include "preparedcache.h"
+#include "resultcache.h"
+#include "shardedindex.h"
+
+namespace spatial {
+
+	// geohash of every point with its geometry index, sorted by geohash
+	using GeohashIndex = std::vector<std::pair<std::string, std::size_t>>;
+
+	// Parameters of an index variant; the defaults are those of GEOS.
+	struct IndexParams{
+		std::size_t nodeCapacity = 10;		// r-tree
+
+		bool operator==(const IndexParams&) const = default;
+	};
+
+	// One index of a dataset: its type, the parameters it is built with and
+	// the index, in the slot of its type. Every slot is an atomically swapped
+	// shared_ptr: a query works on the snapshot it got from load(), a rebuild
+	// publishes the new index with store() once it is complete, and the old
+	// index is freed by the last query still holding it. Queries never see a
+	// missing or partial index.
+	struct IndexSlot{
+		IndexSlot(std::string type, const IndexParams& params) : type(std::move(type)), params(params) {}
+
+		bool isBuilt() const;
+
+		const std::string type;
+		const IndexParams params;
+
+		std::atomic<std::shared_ptr<geos::index::kdtree::KdTree>> kdTree;
+		std::atomic<std::shared_ptr<ShardedIndex<geos::index::quadtree::Quadtree>>> quadTree;
+		std::atomic<std::shared_ptr<ShardedIndex<geos::index::strtree::STRtree>>> rTree;
+		std::atomic<std::shared_ptr<const GeohashIndex>> geohash;
+		std::atomic<std::shared_ptr<const AggregateRTree>> aggregateRTree;
+	};
+
+	// The indexes built on the geometries of a dataset, by name. An index is
+	// named after its type unless it is built under another name, so a layer
+	// can hold several variants of a type, like r-trees of different node
+	// capacities.
+	struct IndexRegistry{
+		// builds running in the background
+		std::atomic<std::size_t> pendingBuilds = 0;
+
+		// Counts one background build in pendingBuilds for its lifetime, so the
+		// count drops even when the build throws.
+		class PendingBuild{
+		public:
+			explicit PendingBuild(IndexRegistry& registry) : registry(registry){
+				registry.pendingBuilds++;
+			}
+			~PendingBuild(){
+				registry.pendingBuilds--;
+			}
+			PendingBuild(const PendingBuild&) = delete;
+			PendingBuild& operator=(const PendingBuild&) = delete;
+
+		private:
+			IndexRegistry& registry;
+		};
+
+		// The index of that name, nullptr when there is none; "linear" has none.
+		std::shared_ptr<IndexSlot> find(const std::string& name) const;
+
+		// The slot to build the index of that name into: the registered one
+		// when it has the same type and parameters, otherwise a new one to
+		// publish() once the index is stored in it. Throws invalid_argument
+		// when the name is taken by an index of another type.
+		std::shared_ptr<IndexSlot> slotFor(const std::string& name, const std::string& type, const IndexParams& params) const;
+
+		// Registers the slot under the name, replacing the previous one.
+		void publish(const std::string& name, std::shared_ptr<IndexSlot> slot);
+
+		// The type of the index of that name: "linear" for linear, empty when
+		// there is no such index.
+		std::string typeOf(const std::string& name) const;
+
+		// "linear" needs no index and is always available
+		bool isBuilt(const std::string& name) const;
+
+		// "linear" followed by the names of the indexes, in the order they
+		// were first built
+		std::vector<std::string> available() const;
+
+		// Heap growth measured over the last build of the index, 0 when unknown.
+		void recordHeapGrowth(const std::string& name, std::uint64_t bytes);
+		std::uint64_t heapGrowth(const std::string& name) const;
+
+	private:
+		mutable std::mutex mutex;
+		std::vector<std::pair<std::string, std::shared_ptr<IndexSlot>>> slots;
+		std::map<std::string, std::uint64_t> heapGrowths;
+	};
+
+	// A named layer: the geometries, their numeric attributes and extent, the
+	// envelope table and the prepared geometry cache used by the exact
+	// predicates, the indexes and the cache of range search results.
+	struct Dataset{
+		Dataset(std::string name, std::vector<std::shared_ptr<geos::geom::Geometry>> geometries, std::size_t preparedCacheCapacity, AttributeTable attributes = {});
+
+		std::vector<const geos::geom::Envelope*> envelopes() const;
+
+		const std::string name;
+		const std::vector<std::shared_ptr<geos::geom::Geometry>> geometries;
+		const AttributeTable attributes;
+		double minX, minY, maxX, maxY;
+		EnvelopeTable envelopeTable;
+		std::unique_ptr<PreparedGeometryCache> preparedCache;
+		IndexRegistry indexes;
+		mutable ResultCache resultCache;
+	};
+
+	// The loaded datasets by name. Commands hold a shared_ptr to the dataset
+	// they work on, so loading a replacement under the same name never pulls
+	// it out from under them.
+	class DatasetRegistry{
+	public:
+		// Adds the dataset, replacing the one with the same name. It becomes
+		// the active dataset unless activate is false and another one is.
+		void put(std::shared_ptr<Dataset> dataset, bool activate = true);
+
+		// The dataset with that name, or the active one when the name is
+		// empty; nullptr when there is none.
+		std::shared_ptr<Dataset> get(const std::string& name = "") const;
+
+		std::vector<std::shared_ptr<Dataset>> list() const;
+
+		std::string activeName() const;
+
+	private:
+		mutable std::mutex mutex;
+		std::map<std::string, std::shared_ptr<Dataset>> datasets;
+		std::string active;
+	};
+}
+
+#endif
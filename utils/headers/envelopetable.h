@@ -0,0 +1,118 @@
+#ifndef ENVELOPETABLE_H_
+#define ENVELOPETABLE_H_
+
+#include <geos/geom/Envelope.h>
+#include <geos/geom/Geometry.h>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "phasetimer.h"
+
+namespace spatial {
+
+	enum class EnvelopePredicate{
+		contains,	// feature envelope inside the query envelope
+		intersects	// feature envelope touches the query envelope
+	};
+
+	// Feature envelopes stored as four contiguous columns, so that predicate
+	// tests can be evaluated several features at a time. Selections are
+	// returned as bitmaps: bit i of word i/64 is set when feature i matches.
+	class EnvelopeTable{
+	public:
+		constexpr static std::size_t BLOCK_SIZE = 4096;
+
+		void build(const std::vector<std::shared_ptr<geos::geom::Geometry>>& geometries);
+		void clear();
+
+		std::size_t size() const{
+			return minX.size();
+		}
+
+		// name of the kernel chosen for this cpu: "avx512", "avx2" or "scalar";
+		// the SPATIAL_KERNEL environment variable can ask for a narrower one
+		static const char* kernelName();
+
+		// Tests features [begin, begin + count) and writes (count + 63) / 64 words.
+		void select(EnvelopePredicate predicate, const geos::geom::Envelope& query, std::size_t begin, std::size_t count, std::uint64_t* selection) const;
+
+		// Tests the features ids[0..count), count <= 64, and returns the selection word.
+		std::uint64_t select(EnvelopePredicate predicate, const geos::geom::Envelope& query, const std::size_t* ids, std::size_t count) const;
+
+		// Calls visitor(idx) for every feature matching the predicate.
+		template<typename Visitor>
+		void scan(EnvelopePredicate predicate, const geos::geom::Envelope& query, Visitor&& visitor) const;
+
+	private:
+		std::vector<double> minX;
+		std::vector<double> minY;
+		std::vector<double> maxX;
+		std::vector<double> maxY;
+	};
+
+	template<typename F>
+	inline void forEachSelected(const std::uint64_t* selection, std::size_t count, F&& f){
+		for(std::size_t w = 0; w*64 < count; w++){
+			std::uint64_t bits = selection[w];
+			while(bits){
+				f(w*64 + std::countr_zero(bits));
+				bits &= bits - 1;
+			}
+		}
+	}
+
+	template<typename Visitor>
+	void EnvelopeTable::scan(EnvelopePredicate predicate, const geos::geom::Envelope& query, Visitor&& visitor) const{
+
+		std::array<std::uint64_t, BLOCK_SIZE/64> selection;
+
+		for(std::size_t begin = 0; begin < size(); begin += BLOCK_SIZE){
+
+			const std::size_t count = std::min(BLOCK_SIZE, size() - begin);
+
+			select(predicate, query, begin, count, selection.data());
+			forEachSelected(selection.data(), count, [&visitor, begin](const std::size_t i){
+				visitor(begin + i);
+			});
+		}
+	}
+
+	// Collects candidate ids coming from an index traversal and refines them
+	// against the envelope table 64 at a time, forwarding the matches.
+	template<typename Visitor>
+	class RefineBuffer{
+	public:
+		RefineBuffer(const EnvelopeTable& table, EnvelopePredicate predicate, const geos::geom::Envelope& query, Visitor& visitor) :
+			table(table), predicate(predicate), query(query), visitor(visitor) {}
+
+		void push(const std::size_t idx){
+			ids[count++] = idx;
+			if(count == ids.size()){
+				flush();
+			}
+		}
+
+		void flush(){
+			ScopedPhase phase(Phase::envelopeRefine);
+			const std::uint64_t selection = table.select(predicate, query, ids.data(), count);
+			forEachSelected(&selection, count, [this](const std::size_t i){
+				visitor(ids[i]);
+			});
+			count = 0;
+		}
+
+	private:
+		const EnvelopeTable& table;
+		const EnvelopePredicate predicate;
+		const geos::geom::Envelope& query;
+		Visitor& visitor;
+
+		std::array<std::size_t, 64> ids;
+		std::size_t count = 0;
+	};
+}
+
+#endif
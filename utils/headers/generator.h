@@ -0,0 +1,53 @@
+#ifndef GENERATOR_H_
+#define GENERATOR_H_
+
+#include <geos/geom/Geometry.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "attributes.h"
+
+namespace spatial {
+
+	class ThreadPool;
+
+	enum class FeatureKind{
+		points,
+		lines,
+		polygons
+	};
+
+	// Where the features are placed.
+	enum class Layout{
+		uniform,		// anywhere in the extent
+		clusters,		// gaussian clusters of different sizes
+		roads,			// along a network of winding roads, lines following them
+		overlapping		// uniform, sized so that every feature overlaps about `overlap` others
+	};
+
+	struct LayerSpec{
+		FeatureKind kind = FeatureKind::points;
+		Layout layout = Layout::uniform;
+		std::size_t count = 100000;
+		std::uint64_t seed = 42;
+		double extent = 100000;		// the layer covers [0, extent] x [0, extent]; at most 90 for geohash, which takes degrees
+		std::size_t clusters = 50;
+		double spread = 0.01;		// standard deviation of a cluster, relative to the extent
+		double size = 0.001;		// mean length of the lines and diameter of the polygons, relative to the extent
+		double skew = 0;			// sigma of the lognormal size distribution, 0 for equal sizes
+		double overlap = 10;
+	};
+
+	bool parseFeatureKind(const std::string& name, FeatureKind& kind);
+	bool parseLayout(const std::string& name, Layout& layout);
+	std::string describe(const LayerSpec& spec);
+
+	// Generates the features of the layer and a numeric "size" attribute
+	// holding the size each one was drawn with. The features are made in
+	// blocks seeded from the layer seed, so the layer only depends on the
+	// spec, whatever the number of threads of the pool.
+	std::vector<std::shared_ptr<geos::geom::Geometry>> generateLayer(const LayerSpec& spec, AttributeTable& attributes, ThreadPool* pool = nullptr);
+}
+
+#endif
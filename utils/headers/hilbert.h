@@ -0,0 +1,68 @@
+#ifndef HILBERT_H_
+#define HILBERT_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+namespace spatial {
+
+	// Position of the cell (x, y) along the Hilbert curve filling a
+	// 2^order x 2^order grid.
+	inline std::uint64_t hilbertIndex(std::uint32_t x, std::uint32_t y, const unsigned order){
+
+		const std::uint32_t n = std::uint32_t(1) << order;
+		std::uint64_t d = 0;
+
+		for(std::uint32_t s = n / 2; s > 0; s /= 2){
+			const std::uint32_t rx = (x & s) > 0;
+			const std::uint32_t ry = (y & s) > 0;
+			d += std::uint64_t(s) * s * ((3 * rx) ^ ry);
+
+			if(ry == 0){
+				if(rx == 1){
+					x = n - 1 - x;
+					y = n - 1 - y;
+				}
+				std::swap(x, y);
+			}
+		}
+
+		return d;
+	}
+
+	// Maps coordinates inside an extent to their Hilbert index, so that sorting
+	// by index keeps nearby points next to each other.
+	class HilbertCurve{
+	public:
+		constexpr static unsigned ORDER = 16;
+
+		HilbertCurve(double minX, double minY, double maxX, double maxY) :
+			minX(minX), minY(minY),
+			scaleX(maxX > minX ? CELLS / (maxX - minX) : 0),
+			scaleY(maxY > minY ? CELLS / (maxY - minY) : 0) {}
+
+		std::uint64_t index(double x, double y) const{
+			return hilbertIndex(toCell(x, minX, scaleX), toCell(y, minY, scaleY), ORDER);
+		}
+
+	private:
+		constexpr static double CELLS = double(std::uint32_t(1) << ORDER);
+
+		static std::uint32_t toCell(double value, double min, double scale){
+			const double cell = (value - min) * scale;
+			// also maps NaN to cell 0
+			if(!(cell > 0)){
+				return 0;
+			}
+			return static_cast<std::uint32_t>(std::min(cell, CELLS - 1));
+		}
+
+		double minX;
+		double minY;
+		double scaleX;
+		double scaleY;
+	};
+}
+
+#endif
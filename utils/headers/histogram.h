@@ -0,0 +1,53 @@
+#ifndef HISTOGRAM_H_
+#define HISTOGRAM_H_
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+
+namespace spatial {
+
+	// Latency histogram with logarithmic buckets in the style of HdrHistogram:
+	// values below 128 have a bucket each, larger values share a bucket with
+	// the values of the same power of two and the same top 7 bits, so every
+	// value is known within 1/64 of itself. Recording is a few instructions
+	// and the memory is fixed, whatever the number of samples.
+	class LatencyHistogram{
+	public:
+		constexpr static unsigned SUB_BUCKET_BITS = 7;
+		constexpr static std::size_t BUCKETS = (64 - SUB_BUCKET_BITS + 1) * (std::size_t(1) << (SUB_BUCKET_BITS - 1)) + (std::size_t(1) << (SUB_BUCKET_BITS - 1));
+
+		void record(std::uint64_t value);
+		void merge(const LatencyHistogram& other);
+		void clear();
+
+		std::uint64_t count() const{
+			return total;
+		}
+
+		std::uint64_t max() const{
+			return maximum;
+		}
+
+		double mean() const;
+
+		// Highest value of the bucket holding the given quantile, in [0, 1];
+		// never more than the largest value recorded.
+		std::uint64_t percentile(double quantile) const;
+
+		// Writes the non-empty buckets as "lower upper count" lines.
+		void dump(std::ostream& out) const;
+
+	private:
+		static std::size_t bucketOf(std::uint64_t value);
+		static std::uint64_t lowestOf(std::size_t bucket);
+		static std::uint64_t highestOf(std::size_t bucket);
+
+		std::array<std::uint64_t, BUCKETS> counts{};
+		std::uint64_t total = 0;
+		std::uint64_t maximum = 0;
+		long double sum = 0;
+	};
+}
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef INDEXSTATS_H_
+#define INDEXSTATS_H_
+
+#include <geos/index/kdtree/KdTree.h>
+#include <geos/index/quadtree/Quadtree.h>
+#include <geos/index/strtree/STRtree.h>
+#include <cstdint>
+#include <string>
+#include "aggregatetree.h"
+#include "dataset.h"
+#include "envelopetable.h"
+#include "shardedindex.h"
+
+namespace spatial {
+
+	// Bytes the heap allocator holds for live allocations, chunk headers
+	// included (glibc mallinfo2); 0 when unknown.
+	std::uint64_t heapInUse();
+
+	// Size of the chunk glibc malloc hands out for a request of that many
+	// bytes, so the overhead of many small allocations can be accounted.
+	std::uint64_t allocationSize(std::uint64_t bytes);
+
+	// Memory and shape of an index. The bytes are accounted from the layout
+	// of the structure, as requested from the allocator; overheadBytes is
+	// what the allocator adds on top. Parts a structure does not expose are
+	// left at 0 and explained in the note.
+	struct IndexStats{
+		std::uint64_t entries = 0;
+		std::uint64_t nodeBytes = 0;
+		std::uint64_t itemBytes = 0;
+		std::uint64_t keyBytes = 0;
+		std::uint64_t overheadBytes = 0;
+
+		std::uint64_t nodes = 0;
+		std::uint64_t leaves = 0;
+		std::size_t depth = 0;
+		double fanout = 0;			// mean children of the inner nodes
+		double occupancy = 0;		// mean entries of a leaf over the node capacity
+		double overlap = 0;			// area shared by sibling nodes over their total area
+		std::string note;
+
+		std::uint64_t totalBytes() const{
+			return nodeBytes + itemBytes + keyBytes + overheadBytes;
+		}
+	};
+
+	IndexStats kdTreeStats(geos::index::kdtree::KdTree& tree);
+	IndexStats quadTreeStats(ShardedIndex<geos::index::quadtree::Quadtree>& index);
+	IndexStats rTreeStats(ShardedIndex<geos::index::strtree::STRtree>& index);
+	IndexStats geohashStats(const GeohashIndex& index);
+	IndexStats aggregateTreeStats(const AggregateRTree& tree);
+	IndexStats envelopeTableStats(const EnvelopeTable& table);
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef OPTIONS_H_
+#define OPTIONS_H_
+
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace spatial {
+
+	// Splits free-form command arguments into positional values, "--name value"
+	// options and "--flag" switches. Unknown names throw std::invalid_argument.
+	class Options{
+	public:
+		Options(const std::vector<std::string>& args, const std::set<std::string>& valueNames, const std::set<std::string>& flagNames = {});
+
+		const std::vector<std::string>& positional() const{
+			return positionalArgs;
+		}
+
+		bool has(const std::string& name) const{
+			return values.contains(name) || flags.contains(name);
+		}
+
+		template<typename T>
+		T get(const std::string& name, const T& defaultValue) const;
+
+	private:
+		std::vector<std::string> positionalArgs;
+		std::map<std::string, std::string> values;
+		std::set<std::string> flags;
+	};
+
+	template<typename T>
+	T parseValue(const std::string& name, const std::string& text){
+
+		if constexpr (std::is_same_v<T, std::string>){
+			return text;
+		}else{
+			std::istringstream iss(text);
+			T value;
+			if(!(iss >> value) || !iss.eof()){
+				throw std::invalid_argument("invalid value '" + text + "' for " + name);
+			}
+			return value;
+		}
+	}
+
+	template<typename T>
+	T Options::get(const std::string& name, const T& defaultValue) const{
+
+		auto it = values.find(name);
+		if(it == values.end()){
+			return defaultValue;
+		}
+		return parseValue<T>("--" + name, it->second);
+	}
+}
+
+#endif
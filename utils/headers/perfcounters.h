@@ -0,0 +1,72 @@
+#ifndef PERFCOUNTERS_H_
+#define PERFCOUNTERS_H_
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace spatial {
+
+	enum class Counter{
+		cycles,
+		instructions,
+		l1dMisses,		// L1 data cache read misses
+		llcMisses,		// last level cache misses
+		branchMisses,
+		dtlbMisses,		// data TLB read misses
+	};
+
+	constexpr std::size_t COUNTERS = 6;
+
+	const char* counterName(Counter counter);
+
+	struct CounterValues{
+		std::array<double, COUNTERS> values{};
+		std::array<bool, COUNTERS> available{};
+
+		double operator[](const Counter counter) const{
+			return values[static_cast<std::size_t>(counter)];
+		}
+
+		bool has(const Counter counter) const{
+			return available[static_cast<std::size_t>(counter)];
+		}
+	};
+
+	// Hardware counters of the calling thread, read with perf_event_open and
+	// counting user space only. Each counter is opened on its own, so the
+	// ones the CPU lacks (the TLB events under many hypervisors) are skipped
+	// and the others still work; when the kernel schedules more events than
+	// the PMU holds, the counts are scaled by the time each one was running.
+	// Opening fails as a whole when perf events are not permitted, see
+	// /proc/sys/kernel/perf_event_paranoid.
+	class PerfCounters{
+	public:
+		PerfCounters();
+		~PerfCounters();
+
+		PerfCounters(const PerfCounters&) = delete;
+		PerfCounters& operator=(const PerfCounters&) = delete;
+
+		// True when at least one counter could be opened.
+		bool available() const{
+			return opened > 0;
+		}
+
+		// Why no counter could be opened.
+		const std::string& error() const{
+			return failure;
+		}
+
+		// Both must be called on the thread that constructed the counters.
+		void start();
+		CounterValues stop();
+
+	private:
+		std::array<int, COUNTERS> fds;
+		std::size_t opened = 0;
+		std::string failure;
+	};
+}
+
+#endif
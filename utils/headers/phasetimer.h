@@ -0,0 +1,113 @@
+#ifndef PHASETIMER_H_
+#define PHASETIMER_H_
+
+#include <array>
+#include <cstdint>
+
+#ifdef SPATIAL_PROFILE_PHASES
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+#endif
+
+namespace spatial {
+
+	// The phases a search or a build is split into by the phase timers.
+	enum class Phase{
+		traversal,		// walking the index and handing out candidate ids
+		envelopeRefine,	// testing the candidates against the envelope table
+		exactRefine,	// exact predicates on the real geometries
+		partition,		// sorting the items into build partitions
+		insert,			// filling the index
+		sort,			// final ordering of the index entries
+	};
+
+	constexpr std::size_t PHASES = 6;
+
+	const char* phaseName(Phase phase);
+
+	// Time spent in each phase by one thread, in ticks. Nested phases are
+	// exclusive: the time of a refinement running inside a traversal is only
+	// counted as refinement.
+	struct PhaseTotals{
+		std::array<std::uint64_t, PHASES> ticks{};
+		std::array<std::uint64_t, PHASES> calls{};
+	};
+
+	// Ticks of the timestamp counter per nanosecond, measured once.
+	double ticksPerNanosecond();
+
+#ifdef SPATIAL_PROFILE_PHASES
+
+	constexpr bool PHASE_TIMERS = true;
+
+	inline std::uint64_t readTicks(){
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+	}
+
+	struct PhaseStack{
+		PhaseTotals totals;
+		std::array<Phase, 16> phases;
+		std::size_t depth = 0;
+		std::uint64_t last = 0;
+	};
+
+	inline thread_local PhaseStack phaseStack;
+
+	// Counts the time until the end of the scope as the phase, pausing the
+	// phase it is nested in. Two timestamp reads per scope.
+	class ScopedPhase{
+	public:
+		explicit ScopedPhase(const Phase phase){
+			const std::uint64_t now = readTicks();
+			PhaseStack& stack = phaseStack;
+			if(stack.depth > 0){
+				stack.totals.ticks[static_cast<std::size_t>(stack.phases[stack.depth - 1])] += now - stack.last;
+			}
+			stack.phases[stack.depth++] = phase;
+			stack.last = now;
+		}
+
+		~ScopedPhase(){
+			const std::uint64_t now = readTicks();
+			PhaseStack& stack = phaseStack;
+			const std::size_t phase = static_cast<std::size_t>(stack.phases[--stack.depth]);
+			stack.totals.ticks[phase] += now - stack.last;
+			stack.totals.calls[phase]++;
+			stack.last = now;
+		}
+
+		ScopedPhase(const ScopedPhase&) = delete;
+		ScopedPhase& operator=(const ScopedPhase&) = delete;
+	};
+
+	// totals of the calling thread
+	inline PhaseTotals& threadPhaseTotals(){
+		return phaseStack.totals;
+	}
+
+#else
+
+	constexpr bool PHASE_TIMERS = false;
+
+	// compiled out: configure with -DSPATIAL_PROFILE_PHASES=ON to enable
+	class ScopedPhase{
+	public:
+		explicit ScopedPhase(Phase){}
+	};
+
+	inline PhaseTotals& threadPhaseTotals(){
+		thread_local PhaseTotals empty;
+		return empty;
+	}
+
+#endif
+}
+
+#endif
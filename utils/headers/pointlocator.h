@@ -0,0 +1,35 @@
+#ifndef POINTLOCATOR_H_
+#define POINTLOCATOR_H_
+
+#include <geos/algorithm/locate/IndexedPointInAreaLocator.h>
+#include <geos/geom/Coordinate.h>
+#include <geos/geom/Geometry.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace spatial {
+
+	// Point-in-polygon tests against the polygons of a layer. Polygons with
+	// many vertices get an edge index the first time they are tested; the
+	// index is fully built before it is published, so any number of threads
+	// can then query it.
+	class PolygonLayerLocator{
+	public:
+		constexpr static std::size_t INDEX_MIN_POINTS = 32;
+
+		explicit PolygonLayerLocator(const std::vector<std::shared_ptr<geos::geom::Geometry>>& polygons);
+
+		// true when the point is in the interior or on the boundary of polygon id
+		bool covers(std::size_t id, const geos::geom::CoordinateXY& point);
+
+		std::size_t indexedPolygons() const;
+
+	private:
+		const std::vector<std::shared_ptr<geos::geom::Geometry>>& polygons;
+		std::unique_ptr<std::once_flag[]> indexOnce;
+		std::vector<std::unique_ptr<geos::algorithm::locate::IndexedPointInAreaLocator>> indexes;
+	};
+}
+
+#endif
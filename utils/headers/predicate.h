@@ -0,0 +1,78 @@
+#ifndef PREDICATE_H_
+#define PREDICATE_H_
+
+#include <geos/geom/Envelope.h>
+#include <geos/geom/Geometry.h>
+#include <geos/geom/prep/PreparedGeometry.h>
+#include <memory>
+#include <string>
+#include "envelopetable.h"
+
+namespace spatial {
+
+	class PreparedGeometryCache;
+
+	// How a feature has to relate to the query region to be part of the result.
+	enum class Predicate{
+		bbox,		// feature envelope inside the query envelope
+		intersects,	// feature geometry intersects the query region
+		contains,	// feature geometry contains the query region
+		within		// feature geometry lies within the query region
+	};
+
+	bool parsePredicate(const std::string& name, Predicate& predicate);
+	const char* predicateName(Predicate predicate);
+
+	// Envelope test that every feature satisfying the predicate passes, used
+	// to filter the index candidates before the exact test.
+	inline EnvelopePredicate envelopeFilter(Predicate predicate){
+		return (predicate == Predicate::bbox || predicate == Predicate::within) ? EnvelopePredicate::contains : EnvelopePredicate::intersects;
+	}
+
+	// Position of an index node relative to the query region.
+	enum class Coverage{
+		outside,	// no item of the node can match
+		boundary,	// items have to be tested one by one
+		inside		// the node lies in the interior of the region
+	};
+
+	// The shape a query is run with. Rectangles are left to GEOS rectangle
+	// fast paths, any other shape is prepared once per query.
+	class QueryRegion{
+	public:
+		explicit QueryRegion(const geos::geom::Envelope& envelope);
+		explicit QueryRegion(std::unique_ptr<geos::geom::Geometry> geometry);
+
+		const geos::geom::Envelope& getEnvelope() const{
+			return envelope;
+		}
+
+		const geos::geom::Geometry& getGeometry() const{
+			return *geometry;
+		}
+
+		// nullptr when the region is a rectangle
+		const geos::geom::prep::PreparedGeometry* getPrepared() const{
+			return prepared.get();
+		}
+
+		// Classifies the envelope of an index node. Every geometry inside an
+		// `inside` node intersects the region and lies within it.
+		Coverage classify(const geos::geom::Envelope& nodeEnvelope) const;
+
+	private:
+		geos::geom::Envelope envelope;
+		std::unique_ptr<geos::geom::Geometry> geometry;
+		std::unique_ptr<geos::geom::prep::PreparedGeometry> prepared;
+	};
+
+	// Exact test of feature `id` against the region. The cache, when given,
+	// supplies prepared versions of the features that are hit repeatedly.
+	bool evaluate(Predicate predicate, const QueryRegion& region, std::size_t id, const geos::geom::Geometry& feature, PreparedGeometryCache* cache);
+
+	// Exact test of a join pair: feature `id` of the cached layer against a
+	// geometry of another layer, which takes the place of the query region.
+	bool evaluatePair(Predicate predicate, std::size_t id, const geos::geom::Geometry& feature, const geos::geom::Geometry& other, PreparedGeometryCache* cache);
+}
+
+#endif
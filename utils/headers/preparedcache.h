@@ -0,0 +1,104 @@
+#ifndef PREPAREDCACHE_H_
+#define PREPAREDCACHE_H_
+
+#include <geos/geom/Geometry.h>
+#include <geos/geom/prep/PreparedGeometry.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace spatial {
+
+	// Keeps prepared versions of the data geometries that keep coming up in
+	// exact predicate tests. A geometry is prepared on its second hit and the
+	// least recently used entries are dropped beyond the capacity.
+	class PreparedGeometryCache{
+	private:
+		// GEOS builds the indexes of a prepared geometry lazily, so a copy
+		// cannot be used by two threads at once: an entry keeps the copies
+		// not in use, and gets one more copy for every thread that finds them
+		// all taken. Threads testing the same hot polygon then each get their
+		// own copy instead of waiting for each other.
+		struct Entry{
+			std::mutex mutex;
+			std::vector<std::unique_ptr<geos::geom::prep::PreparedGeometry>> idle;
+		};
+
+	public:
+		constexpr static std::uint32_t PREPARE_AFTER_HITS = 2;
+		constexpr static std::size_t PREPARE_MIN_POINTS = 16;
+
+		// One copy of a prepared geometry, given back to its entry when the
+		// lease ends.
+		class Lease{
+		public:
+			Lease() = default;
+			Lease(std::shared_ptr<Entry> entry, std::unique_ptr<geos::geom::prep::PreparedGeometry> prepared) : entry(std::move(entry)), prepared(std::move(prepared)) {}
+			Lease(Lease&&) = default;
+			Lease& operator=(Lease&& other){
+				giveBack();
+				entry = std::move(other.entry);
+				prepared = std::move(other.prepared);
+				return *this;
+			}
+			~Lease(){
+				giveBack();
+			}
+
+			const geos::geom::prep::PreparedGeometry* get() const{
+				return prepared.get();
+			}
+
+		private:
+			void giveBack(){
+				if(entry && prepared){
+					std::lock_guard lock(entry->mutex);
+					entry->idle.push_back(std::move(prepared));
+				}
+			}
+
+			std::shared_ptr<Entry> entry;
+			std::unique_ptr<geos::geom::prep::PreparedGeometry> prepared;
+		};
+
+		struct Statistics{
+			std::size_t lookups = 0;
+			std::size_t hits = 0;
+			std::size_t prepared = 0;	// copies, one per thread using a geometry at once
+			std::size_t evicted = 0;
+			std::size_t entries = 0;
+		};
+
+		PreparedGeometryCache(std::size_t geometryCount, std::size_t capacity);
+
+		// Empty lease when the geometry is not (yet) worth preparing.
+		Lease lease(std::size_t id, const geos::geom::Geometry& geometry);
+
+		Statistics statistics() const;
+
+	private:
+		constexpr static std::size_t SHARDS = 16;
+
+		struct Shard{
+			mutable std::mutex mutex;
+			std::list<std::size_t> recent;
+			std::unordered_map<std::size_t, std::pair<std::shared_ptr<Entry>, std::list<std::size_t>::iterator>> entries;
+		};
+
+		std::unique_ptr<std::atomic<std::uint32_t>[]> hitCounts;
+		std::size_t shardCapacity;
+		std::array<Shard, SHARDS> shards;
+
+		std::atomic<std::size_t> lookups = 0;
+		std::atomic<std::size_t> hits = 0;
+		std::atomic<std::size_t> prepared = 0;
+		std::atomic<std::size_t> evicted = 0;
+	};
+}
+
+#endif
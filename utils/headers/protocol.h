@@ -0,0 +1,132 @@
+#ifndef PROTOCOL_H_
+#define PROTOCOL_H_
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+// Binary protocol of the query server. Every frame starts with a u32 holding
+// the size of the rest of the frame.
+//
+//   request:  u32 size | u8 opcode | u32 request id | payload
+//   response: u32 size | u32 request id | u8 status | payload
+//
+// Numbers are in host byte order (little-endian on the supported platforms),
+// strings are a u16 length followed by the bytes. An empty dataset name means
+// the active dataset, and an index is named by its type or by the name it was
+// built under. Responses to pipelined requests can come back in any
+// order and are matched by the request id.
+//
+//   load    string file, string name                  -> u64 geometries
+//   build   string dataset, string type, u32 threads  -> f64 milliseconds
+//   search  string dataset, string index, u8 predicate,
+//           f64 x1, f64 y1, f64 x2, f64 y2            -> u32 count, count x u32 id
+//   knn     string dataset, string index, f64 x, f64 y,
+//           u32 k                                     -> u32 count, count x (u32 id, f64 distance)
+//   info    string dataset                            -> u64 geometries, f64 minX, minY, maxX, maxY
+//
+// A failed request gets status error and a string message as payload.
+namespace spatial::protocol {
+
+	enum class Opcode : std::uint8_t{
+		load = 1,
+		build = 2,
+		search = 3,
+		knn = 4,
+		info = 5
+	};
+
+	enum class Status : std::uint8_t{
+		ok = 0,
+		error = 1
+	};
+
+	constexpr std::uint32_t MAX_FRAME_SIZE = 64u << 20;
+	constexpr std::size_t REQUEST_HEADER_SIZE = 4 + 1 + 4;
+	constexpr std::size_t RESPONSE_HEADER_SIZE = 4 + 4 + 1;
+
+	class Writer{
+	public:
+		template<typename T>
+		Writer& put(const T value){
+			static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>);
+			buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+			return *this;
+		}
+
+		Writer& putString(const std::string& text){
+			if(text.size() > UINT16_MAX){
+				throw std::length_error("string too long for the protocol");
+			}
+			put(static_cast<std::uint16_t>(text.size()));
+			buffer.append(text);
+			return *this;
+		}
+
+		const std::string& data() const{
+			return buffer;
+		}
+
+		std::string take(){
+			return std::move(buffer);
+		}
+
+	private:
+		std::string buffer;
+	};
+
+	class Reader{
+	public:
+		Reader(const char* data, std::size_t size) : position(data), end(data + size) {}
+		explicit Reader(const std::string& data) : Reader(data.data(), data.size()) {}
+		explicit Reader(std::string&& data) = delete;	// would point into a temporary
+
+		template<typename T>
+		T get(){
+			static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>);
+			require(sizeof(T));
+			T value;
+			std::memcpy(&value, position, sizeof(T));
+			position += sizeof(T);
+			return value;
+		}
+
+		std::string getString(){
+			const std::uint16_t size = get<std::uint16_t>();
+			require(size);
+			std::string text(position, size);
+			position += size;
+			return text;
+		}
+
+		std::size_t remaining() const{
+			return end - position;
+		}
+
+	private:
+		void require(std::size_t size) const{
+			if(remaining() < size){
+				throw std::runtime_error("truncated message");
+			}
+		}
+
+		const char* position;
+		const char* end;
+	};
+
+	inline std::string requestFrame(Opcode opcode, std::uint32_t id, const std::string& payload){
+		Writer frame;
+		frame.put(static_cast<std::uint32_t>(1 + 4 + payload.size())).put(opcode).put(id);
+		return frame.take() + payload;
+	}
+
+	inline std::string responseFrame(std::uint32_t id, Status status, const std::string& payload){
+		Writer frame;
+		frame.put(static_cast<std::uint32_t>(4 + 1 + payload.size())).put(id).put(status);
+		return frame.take() + payload;
+	}
+}
+
+#endif
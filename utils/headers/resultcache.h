@@ -0,0 +1,114 @@
+#ifndef RESULTCACHE_H_
+#define RESULTCACHE_H_
+
+#include <geos/geom/Envelope.h>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "envelopetable.h"
+
+namespace spatial {
+
+	// Candidates of the range searches of a dataset, for clients asking the
+	// same envelopes over and over, like map viewers asking for tiles. The
+	// query envelope is enlarged to the cells of a grid of the given
+	// resolution, and an entry holds the features whose envelope intersects
+	// those cells: a superset of the results of every envelope and predicate
+	// with the same cells, which refine() narrows to the query. The least
+	// recently used entries are dropped beyond the byte budget; a budget of 0
+	// disables the cache.
+	class ResultCache{
+	public:
+		struct Key{
+			std::int64_t minX, minY, maxX, maxY;	// grid cells
+			std::string index;
+
+			bool operator==(const Key&) const = default;
+		};
+
+		struct Statistics{
+			std::size_t lookups = 0;
+			std::size_t hits = 0;
+			std::size_t evicted = 0;
+			std::size_t invalidated = 0;
+			std::size_t entries = 0;
+			std::size_t bytes = 0;
+			std::size_t budget = 0;
+			double resolution = 0;
+		};
+
+		// Sets the budget, evicting down to it, and the resolution; changing
+		// the resolution drops every entry.
+		void configure(std::size_t budget, double resolution);
+
+		bool enabled() const;
+
+		Key key(const std::string& index, const geos::geom::Envelope& envelope) const;
+
+		// The cells of the key, which cover the envelope it was made from: the
+		// envelope the candidates are searched with.
+		geos::geom::Envelope cellEnvelope(const Key& key) const;
+
+		// Copies the candidates of the entry into ids; false on a miss.
+		bool lookup(const Key& key, std::vector<std::size_t>& ids);
+
+		// Candidates larger than the budget are not kept.
+		void insert(const Key& key, const std::vector<std::size_t>& ids);
+
+		// Calls visitor(id) for the candidates whose envelope passes the filter
+		// against the query envelope, in the order of the candidates.
+		template<typename Visitor>
+		static void refine(const EnvelopeTable& table, EnvelopePredicate filter, const geos::geom::Envelope& query, const std::vector<std::size_t>& candidates, Visitor&& visitor);
+
+		// Drops the entries of an index, when it is rebuilt. The features of a
+		// dataset never change: a new dataset comes with an empty cache.
+		void invalidate(const std::string& index);
+
+		void clear();
+
+		Statistics statistics() const;
+
+	private:
+		struct KeyHash{
+			std::size_t operator()(const Key& key) const;
+		};
+
+		struct Entry{
+			Key key;
+			std::vector<std::size_t> ids;
+			std::size_t bytes;
+		};
+
+		using EntryList = std::list<Entry>;
+
+		void erase(EntryList::iterator entry);
+		void evict();
+
+		mutable std::mutex mutex;
+		EntryList recent;
+		std::unordered_map<Key, EntryList::iterator, KeyHash> entries;
+		std::size_t budget = 0;
+		double resolution = 1;
+		std::size_t bytes = 0;
+
+		std::size_t lookups = 0;
+		std::size_t hits = 0;
+		std::size_t evicted = 0;
+		std::size_t invalidated = 0;
+	};
+
+	template<typename Visitor>
+	void ResultCache::refine(const EnvelopeTable& table, const EnvelopePredicate filter, const geos::geom::Envelope& query, const std::vector<std::size_t>& candidates, Visitor&& visitor){
+
+		RefineBuffer<Visitor> buffer(table, filter, query, visitor);
+		for(const std::size_t id : candidates){
+			buffer.push(id);
+		}
+		buffer.flush();
+	}
+}
+
+#endif
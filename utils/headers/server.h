@@ -0,0 +1,104 @@
+#ifndef SERVER_H_
+#define SERVER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "protocol.h"
+
+namespace spatial {
+
+	// Serves the binary protocol of protocol.h on a Unix domain socket or a
+	// loopback TCP port. One thread runs the epoll loop and does all the socket
+	// I/O; complete requests go to a pool of query threads, which hand the
+	// responses back to the loop through an eventfd.
+	class QueryServer{
+	public:
+		// Returns the response payload; an exception becomes an error response.
+		using Handler = std::function<std::string(protocol::Opcode opcode, protocol::Reader& payload)>;
+
+		QueryServer(Handler handler, std::size_t threads);
+		~QueryServer();
+
+		QueryServer(const QueryServer&) = delete;
+		QueryServer& operator=(const QueryServer&) = delete;
+
+		// Throw std::system_error when the socket cannot be set up.
+		void listenUnix(const std::string& path);
+		void listenTcp(std::uint16_t port);
+
+		// Serves until stop() is called.
+		void run();
+
+		// Async-signal-safe, so it can be called from a signal handler.
+		void stop();
+
+		struct Statistics{
+			std::uint64_t connections = 0;
+			std::uint64_t requests = 0;
+			std::uint64_t errors = 0;
+		};
+
+		Statistics statistics() const;
+
+	private:
+		struct Connection{
+			explicit Connection(int fd) : fd(fd) {}
+
+			int fd;
+			std::string input;
+			std::string output;
+			std::size_t written = 0;
+			bool writing = false;
+		};
+
+		struct Task{
+			std::uint64_t connection;
+			std::uint32_t id;
+			protocol::Opcode opcode;
+			std::string payload;
+		};
+
+		struct Completion{
+			std::uint64_t connection;
+			std::string frame;
+		};
+
+		void accept();
+		void read(std::uint64_t key);
+		void write(std::uint64_t key);
+		void close(std::uint64_t key);
+		void deliver();
+		void work();
+		void stopWorkers();
+
+		Handler handler;
+		std::string unixPath;
+		int listenFd = -1;
+		int epollFd = -1;
+		int wakeFd = -1;
+		std::atomic<bool> stopRequested = false;
+		std::uint64_t nextKey = 2;	// 0 is the listening socket, 1 the eventfd
+		std::unordered_map<std::uint64_t, Connection> connections;
+		Statistics stats;
+		mutable std::mutex statsMutex;
+
+		std::mutex tasksMutex;
+		std::condition_variable tasksReady;
+		std::deque<Task> tasks;
+		bool stopping = false;
+		std::vector<std::thread> workers;
+
+		std::mutex completionsMutex;
+		std::vector<Completion> completions;
+	};
+}
+
+#endif
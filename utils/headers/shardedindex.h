@@ -0,0 +1,123 @@
+#ifndef SHARDEDINDEX_H_
+#define SHARDEDINDEX_H_
+
+#include <geos/geom/Envelope.h>
+#include <geos/index/ItemVisitor.h>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "phasetimer.h"
+#include "threadpool.h"
+
+namespace spatial {
+
+	// Splits the items into `parts` groups of about the same size using
+	// sort-tile-recursive slicing of the envelope centres: vertical slabs
+	// sorted by x, each cut into tiles sorted by y.
+	std::vector<std::vector<std::size_t>> partitionSTR(const std::vector<const geos::geom::Envelope*>& envelopes, std::size_t parts, ThreadPool& pool);
+
+	struct BuildStats{
+		std::size_t shards = 0;
+		double partitionTime = 0;	// milliseconds
+		double shardsTime = 0;		// milliseconds, wall clock
+		double shardsWork = 0;		// milliseconds, summed over the shards
+	};
+
+	// A GEOS spatial index (STRtree, Quadtree) built as one shard per STR
+	// partition, each shard on its own thread. GEOS nodes cannot be grafted
+	// into a single tree, so the shard extents act as the merged root level.
+	template<typename Index>
+	class ShardedIndex{
+	public:
+		using Factory = std::function<std::unique_ptr<Index>()>;
+
+		// Every shard is made by the factory, for indexes built with other
+		// parameters than the defaults.
+		explicit ShardedIndex(Factory factory = []{ return std::make_unique<Index>(); }) : factory(std::move(factory)) {}
+
+		BuildStats build(const std::vector<const geos::geom::Envelope*>& envelopes, ThreadPool& pool);
+
+		void query(const geos::geom::Envelope* searchEnv, geos::index::ItemVisitor& visitor){
+			for(Shard& shard : shards){
+				if(shard.extent.intersects(searchEnv)){
+					shard.index->query(searchEnv, visitor);
+				}
+			}
+		}
+
+		std::size_t shardCount() const{
+			return shards.size();
+		}
+
+		// Calls f(extent, index) for every shard.
+		template<typename F>
+		void forEachShard(F&& f){
+			for(Shard& shard : shards){
+				f(static_cast<const geos::geom::Envelope&>(shard.extent), *shard.index);
+			}
+		}
+
+	private:
+		struct Shard{
+			geos::geom::Envelope extent;
+			std::unique_ptr<Index> index;
+		};
+
+		Factory factory;
+		std::vector<Shard> shards;
+	};
+
+	template<typename Index>
+	BuildStats ShardedIndex<Index>::build(const std::vector<const geos::geom::Envelope*>& envelopes, ThreadPool& pool){
+
+		BuildStats stats;
+		shards.clear();
+
+		const auto start = std::chrono::steady_clock::now();
+
+		std::vector<std::vector<std::size_t>> partitions;
+		{
+			ScopedPhase phase(Phase::partition);
+			partitions = partitionSTR(envelopes, pool.size(), pool);
+		}
+
+		const auto partitioned = std::chrono::steady_clock::now();
+		stats.partitionTime = std::chrono::duration<double, std::milli>(partitioned - start).count();
+
+		shards.resize(partitions.size());
+		std::vector<double> shardTimes(partitions.size());
+
+		// timed on the calling thread, so the phase is the wall clock time
+		ScopedPhase phase(Phase::insert);
+		pool.parallelFor(partitions.size(), 1, [&](std::size_t, const std::size_t p){
+
+			const auto shardStart = std::chrono::steady_clock::now();
+
+			Shard& shard = shards[p];
+			shard.index = factory();
+
+			for(const std::size_t i : partitions[p]){
+				shard.extent.expandToInclude(envelopes[i]);
+				shard.index->insert(envelopes[i], reinterpret_cast<void*>(i));
+			}
+
+			// trees that build lazily are built here, on the shard's thread
+			if constexpr (requires { shard.index->build(); }){
+				shard.index->build();
+			}
+
+			shardTimes[p] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shardStart).count();
+		});
+
+		stats.shards = shards.size();
+		stats.shardsTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - partitioned).count();
+		for(const double time : shardTimes){
+			stats.shardsWork += time;
+		}
+
+		return stats;
+	}
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef SPATIALJOIN_H_
+#define SPATIALJOIN_H_
+
+#include <geos/geom/Envelope.h>
+#include <functional>
+#include <vector>
+#include "threadpool.h"
+
+namespace spatial {
+
+	struct JoinStats{
+		std::size_t gridSize = 0;			// the grid has gridSize x gridSize cells
+		std::size_t leftEntries = 0;		// left features replicated into the cells
+		std::size_t rightEntries = 0;		// right features replicated into the cells
+		std::size_t candidates = 0;			// pairs with intersecting envelopes
+		std::size_t pairs = 0;				// pairs satisfying the predicate
+		double partitionTime = 0;			// milliseconds
+		double filterTime = 0;				// milliseconds
+		double refineTime = 0;				// milliseconds
+	};
+
+	// Grid-partitioned join of two layers. Every feature is copied into each
+	// grid cell its envelope overlaps, each cell is plane-swept in parallel to
+	// find the pairs of intersecting envelopes, and a pair is only reported by
+	// the cell holding the lower-left corner of the envelopes intersection, so
+	// replicated features never produce duplicates. The candidate pairs are
+	// then refined in parallel with refine(left, right).
+	JoinStats gridJoin(const std::vector<const geos::geom::Envelope*>& left, const std::vector<const geos::geom::Envelope*>& right,
+					   std::size_t gridSize, ThreadPool& pool, const std::function<bool(std::size_t, std::size_t)>& refine);
+
+	// A grid size giving about a thousand entries per cell, with at least a few
+	// cells per worker.
+	std::size_t defaultJoinGridSize(std::size_t features, std::size_t workers);
+}
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace spatial {
+
+	// Fixed set of worker threads running index-range jobs. The calling thread
+	// takes part in every job as worker 0, so a pool of size 1 has no threads.
+	class ThreadPool{
+	public:
+		explicit ThreadPool(std::size_t threads);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		std::size_t size() const{
+			return threads.size() + 1;
+		}
+
+		// Calls f(worker, i) for every i in [0, count). Each worker starts on its
+		// own contiguous slice taking grain items at a time and, once it runs dry,
+		// steals the upper half of the largest slice left. Returns when all the
+		// items have been processed; the first exception thrown by f is rethrown.
+		template<typename F>
+		void parallelFor(std::size_t count, std::size_t grain, F&& f);
+
+	private:
+		struct alignas(64) Slice{
+			std::mutex mutex;
+			std::size_t begin = 0;
+			std::size_t end = 0;
+		};
+
+		bool nextChunk(std::size_t worker, std::size_t grain, std::size_t& begin, std::size_t& end);
+		void runOnAll(const std::function<void(std::size_t)>& job);
+		void workerLoop(std::size_t worker);
+
+		std::vector<std::thread> threads;
+		std::unique_ptr<Slice[]> slices;
+
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable done;
+		const std::function<void(std::size_t)>* job = nullptr;
+		std::size_t generation = 0;
+		std::size_t running = 0;
+		bool stopping = false;
+	};
+
+	template<typename F>
+	void ThreadPool::parallelFor(std::size_t count, std::size_t grain, F&& f){
+
+		const std::size_t workers = size();
+		grain = std::max<std::size_t>(grain, 1);
+
+		for(std::size_t w = 0; w < workers; w++){
+			slices[w].begin = count * w / workers;
+			slices[w].end = count * (w + 1) / workers;
+		}
+
+		std::exception_ptr error;
+		std::mutex errorMutex;
+
+		runOnAll([this, grain, &f, &error, &errorMutex](const std::size_t worker){
+			std::size_t begin, end;
+			try{
+				while(nextChunk(worker, grain, begin, end)){
+					for(std::size_t i = begin; i < end; i++){
+						f(worker, i);
+					}
+				}
+			}catch(...){
+				std::lock_guard lock(errorMutex);
+				if(!error){
+					error = std::current_exception();
+				}
+			}
+		});
+
+		if(error){
+			std::rethrow_exception(error);
+		}
+	}
+
+	// Sorts each worker's share of [first, last) in parallel, then merges the
+	// sorted runs pairwise, also in parallel.
+	template<typename It, typename Compare>
+	void parallelSort(ThreadPool& pool, It first, It last, Compare comp){
+
+		const std::size_t count = last - first;
+		const std::size_t runs = pool.size();
+
+		if(runs == 1 || count < 4096){
+			std::sort(first, last, comp);
+			return;
+		}
+
+		auto bound = [first, count, runs](const std::size_t run){
+			return first + count * run / runs;
+		};
+
+		pool.parallelFor(runs, 1, [&](std::size_t, const std::size_t run){
+			std::sort(bound(run), bound(run + 1), comp);
+		});
+
+		for(std::size_t width = 1; width < runs; width *= 2){
+			pool.parallelFor((runs + 2*width - 1) / (2*width), 1, [&](std::size_t, const std::size_t merge){
+				const std::size_t lo = merge * 2 * width;
+				const std::size_t mid = std::min(lo + width, runs);
+				const std::size_t hi = std::min(lo + 2*width, runs);
+				if(mid < hi){
+					std::inplace_merge(bound(lo), bound(mid), bound(hi), comp);
+				}
+			});
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef WORKLOAD_H_
+#define WORKLOAD_H_
+
+#include <geos/geom/Envelope.h>
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace spatial {
+
+	enum class QueryKind{
+		point,		// geometries containing a point
+		box,		// range query
+		radius,		// geometries within a distance of a point
+		knn			// the k nearest geometries
+	};
+
+	constexpr std::size_t QUERY_KINDS = 4;
+
+	const char* queryKindName(QueryKind kind);
+
+	struct Query{
+		QueryKind kind = QueryKind::box;
+		double x = 0;	// centre of the query
+		double y = 0;
+		geos::geom::Envelope box;	// box queries
+		double radius = 0;			// radius queries
+		std::size_t k = 0;			// knn queries
+	};
+
+	enum class QueryDistribution{
+		uniform,	// centres spread uniformly over the extent
+		data,		// centres of randomly picked features
+		zipf		// around a few hotspots, picked with Zipf-distributed frequency
+	};
+
+	bool parseDistribution(const std::string& name, QueryDistribution& distribution);
+	const char* distributionName(QueryDistribution distribution);
+
+	struct WorkloadSpec{
+		std::uint64_t seed = 42;
+		QueryDistribution distribution = QueryDistribution::uniform;
+
+		// share of the features a box or radius query should cover; when 0 the
+		// boxes get one of the fixed sizes instead, and the circles the area of
+		// one of them
+		double selectivity = 0;
+		std::vector<std::pair<double, double>> sizes;
+
+		// weights of the query kinds, indexed by QueryKind
+		std::array<double, QUERY_KINDS> mix{0, 1, 0, 0};
+
+		std::size_t hotspots = 16;
+		double zipfExponent = 1.0;
+		double hotspotSpread = 0.01;	// standard deviation, as a share of the extent
+		std::size_t k = 10;
+	};
+
+	// Parses "box=70,point=10,radius=10,knn=10"; kinds not listed get weight 0.
+	bool parseMix(const std::string& text, std::array<double, QUERY_KINDS>& mix);
+
+	std::string describe(const WorkloadSpec& spec);
+
+	// Generates queries over a layer. The same spec and features give the same
+	// queries from run to run with the same standard library; the std
+	// distributions differ between libraries, so only a saved workload file
+	// replays the same queries anywhere.
+	class WorkloadGenerator{
+	public:
+		WorkloadGenerator(const WorkloadSpec& spec, const std::vector<const geos::geom::Envelope*>& features, const geos::geom::Envelope& extent);
+
+		Query next();
+
+		std::vector<Query> generate(std::size_t count);
+
+		// estimated number of features whose centre falls in the box
+		double estimateCount(const geos::geom::Envelope& box) const;
+
+	private:
+		void center(double& x, double& y);
+		double halfSideFor(double x, double y, double features) const;
+		double cumulative(double x, double y) const;
+
+		WorkloadSpec spec;
+		geos::geom::Envelope extent;
+		std::mt19937_64 engine;
+
+		std::vector<std::pair<double, double>> featureCenters;
+		std::vector<std::pair<double, double>> hotspotCenters;
+		std::discrete_distribution<std::size_t> hotspotChoice;
+		std::discrete_distribution<std::size_t> kindChoice;
+
+		// feature centres counted on a GRID x GRID grid over the extent, as
+		// prefix sums with a leading row and column of zeros
+		constexpr static std::size_t GRID = 128;
+		std::vector<double> prefix;
+	};
+
+	// One query per line: "box x1 y1 x2 y2", "point x y", "radius x y r" or
+	// "knn x y k"; lines starting with '#' are comments.
+	void saveWorkload(std::ostream& out, const WorkloadSpec& spec, const std::vector<Query>& queries);
+	bool loadWorkload(std::istream& in, std::vector<Query>& queries, std::string& error);
+}
+
+#endif
@@ -0,0 +1,202 @@
+#include "../headers/aggregatetree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace spatial {
+
+	namespace {
+
+		// Sort-tile-recursive order for nodes of NODE_CAPACITY items: vertical
+		// slabs of whole nodes sorted by x, each slab sorted by y.
+		std::vector<std::uint32_t> strOrder(const std::vector<geos::geom::Envelope>& envelopes){
+
+			const std::size_t count = envelopes.size();
+			const std::size_t capacity = AggregateRTree::NODE_CAPACITY;
+
+			std::vector<std::uint32_t> order(count);
+			std::iota(order.begin(), order.end(), 0);
+
+			auto centerX = [&envelopes](const std::uint32_t i){
+				return envelopes[i].getMinX() + envelopes[i].getMaxX();
+			};
+			auto centerY = [&envelopes](const std::uint32_t i){
+				return envelopes[i].getMinY() + envelopes[i].getMaxY();
+			};
+
+			std::sort(order.begin(), order.end(), [&centerX](const std::uint32_t a, const std::uint32_t b){
+				return centerX(a) < centerX(b);
+			});
+
+			const std::size_t nodes = (count + capacity - 1) / capacity;
+			const std::size_t slabs = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(nodes))));
+			const std::size_t slabSize = (nodes + slabs - 1) / std::max<std::size_t>(slabs, 1) * capacity;
+
+			for(std::size_t begin = 0; begin < count; begin += slabSize){
+				std::sort(order.begin() + begin, order.begin() + std::min(count, begin + slabSize), [&centerY](const std::uint32_t a, const std::uint32_t b){
+					return centerY(a) < centerY(b);
+				});
+			}
+
+			return order;
+		}
+	}
+
+	void AggregateRTree::build(const std::vector<const geos::geom::Envelope*>& envelopes, const AttributeTable& attributes){
+
+		nodes.clear();
+		counts.clear();
+		sums.clear();
+		entryEnvelopes.clear();
+		entryIds.clear();
+		entryValues.clear();
+		fields = attributes.fieldCount();
+
+		std::vector<geos::geom::Envelope> featureEnvelopes;
+		std::vector<std::size_t> featureIds;
+		for(std::size_t i = 0; i < envelopes.size(); i++){
+			if(envelopes[i] && !envelopes[i]->isNull()){
+				featureEnvelopes.push_back(*envelopes[i]);
+				featureIds.push_back(i);
+			}
+		}
+
+		const std::size_t count = featureIds.size();
+
+		for(const std::uint32_t i : strOrder(featureEnvelopes)){
+			entryEnvelopes.push_back(featureEnvelopes[i]);
+			entryIds.push_back(featureIds[i]);
+			for(std::size_t f = 0; f < fields; f++){
+				entryValues.push_back(attributes.columns[f][featureIds[i]]);
+			}
+		}
+
+		// leaves, in the order of their entries
+		for(std::size_t begin = 0; begin < count; begin += NODE_CAPACITY){
+
+			const std::size_t end = std::min(count, begin + NODE_CAPACITY);
+			Node leaf{geos::geom::Envelope(), static_cast<std::uint32_t>(begin), static_cast<std::uint32_t>(end), true};
+
+			std::vector<double> leafSums(fields, 0.0);
+			for(std::size_t e = begin; e < end; e++){
+				leaf.envelope.expandToInclude(entryEnvelopes[e]);
+				for(std::size_t f = 0; f < fields; f++){
+					leafSums[f] += entryValues[e * fields + f];
+				}
+			}
+
+			nodes.push_back(leaf);
+			counts.push_back(end - begin);
+			sums.insert(sums.end(), leafSums.begin(), leafSums.end());
+		}
+
+		// every level is put in STR order before its parents are made, so the
+		// children of a node are contiguous; nothing refers to a level until then
+		std::size_t levelBegin = 0;
+
+		while(nodes.size() - levelBegin > 1){
+
+			const std::size_t levelEnd = nodes.size();
+
+			std::vector<geos::geom::Envelope> levelEnvelopes;
+			for(std::size_t n = levelBegin; n < levelEnd; n++){
+				levelEnvelopes.push_back(nodes[n].envelope);
+			}
+
+			const std::vector<std::uint32_t> order = strOrder(levelEnvelopes);
+			const std::vector<Node> levelNodes(nodes.begin() + levelBegin, nodes.end());
+			const std::vector<std::size_t> levelCounts(counts.begin() + levelBegin, counts.end());
+			const std::vector<double> levelSums(sums.begin() + levelBegin * fields, sums.end());
+
+			for(std::size_t k = 0; k < order.size(); k++){
+				nodes[levelBegin + k] = levelNodes[order[k]];
+				counts[levelBegin + k] = levelCounts[order[k]];
+				std::copy_n(levelSums.begin() + order[k] * fields, fields, sums.begin() + (levelBegin + k) * fields);
+			}
+
+			for(std::size_t begin = levelBegin; begin < levelEnd; begin += NODE_CAPACITY){
+
+				const std::size_t end = std::min(levelEnd, begin + NODE_CAPACITY);
+				Node parent{geos::geom::Envelope(), static_cast<std::uint32_t>(begin), static_cast<std::uint32_t>(end), false};
+
+				std::size_t parentCount = 0;
+				std::vector<double> parentSums(fields, 0.0);
+				for(std::size_t child = begin; child < end; child++){
+					parent.envelope.expandToInclude(nodes[child].envelope);
+					parentCount += counts[child];
+					for(std::size_t f = 0; f < fields; f++){
+						parentSums[f] += sums[child * fields + f];
+					}
+				}
+
+				nodes.push_back(parent);
+				counts.push_back(parentCount);
+				sums.insert(sums.end(), parentSums.begin(), parentSums.end());
+			}
+
+			levelBegin = levelEnd;
+		}
+	}
+
+	Aggregate AggregateRTree::aggregate(EnvelopePredicate predicate, const geos::geom::Envelope& query, AggregateStats* stats) const{
+
+		Aggregate result;
+		result.sums.assign(fields, 0.0);
+
+		AggregateStats local;
+
+		std::vector<std::uint32_t> stack;
+		if(!nodes.empty()){
+			stack.push_back(static_cast<std::uint32_t>(nodes.size() - 1));
+		}
+
+		while(!stack.empty()){
+
+			const std::uint32_t n = stack.back();
+			const Node& node = nodes[n];
+			stack.pop_back();
+
+			local.nodesVisited++;
+
+			if(!node.envelope.intersects(query)){
+				continue;
+			}
+
+			// every feature below passes both predicates
+			if(query.contains(node.envelope)){
+				local.nodesCovered++;
+				result.count += counts[n];
+				for(std::size_t f = 0; f < fields; f++){
+					result.sums[f] += nodeSums(n)[f];
+				}
+				continue;
+			}
+
+			if(node.leaf){
+				for(std::uint32_t e = node.begin; e < node.end; e++){
+
+					local.entriesTested++;
+
+					const bool passes = predicate == EnvelopePredicate::contains ? query.contains(entryEnvelopes[e]) : query.intersects(entryEnvelopes[e]);
+					if(passes){
+						result.count++;
+						for(std::size_t f = 0; f < fields; f++){
+							result.sums[f] += entryValues[e * fields + f];
+						}
+					}
+				}
+			}else{
+				for(std::uint32_t child = node.begin; child < node.end; child++){
+					stack.push_back(child);
+				}
+			}
+		}
+
+		if(stats){
+			*stats = local;
+		}
+
+		return result;
+	}
+}
@@ -0,0 +1,393 @@
+#include "../headers/benchreport.h"
+
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+namespace spatial {
+
+	namespace {
+
+		// column order of the CSV files
+		const std::vector<std::string> FIELDS{"command", "dataset", "index", "workload", "threads", "operations", "throughput", "p50", "p90", "p99", "p999", "max", "memory"};
+
+		std::vector<std::string> fieldValues(const BenchRecord& record){
+
+			auto number = [](const double value){
+				std::ostringstream oss;
+				oss<<std::setprecision(10)<<value;
+				return oss.str();
+			};
+
+			return {record.command, record.dataset, record.index, record.workload,
+				std::to_string(record.threads), std::to_string(record.operations), number(record.throughput),
+				number(record.p50), number(record.p90), number(record.p99), number(record.p999), number(record.max),
+				std::to_string(record.memory)};
+		}
+
+		// Unknown fields are ignored, so older tools read newer files.
+		bool setField(BenchRecord& record, const std::string& name, const std::string& value){
+
+			try{
+				if(name == "command"){
+					record.command = value;
+				}else if(name == "dataset"){
+					record.dataset = value;
+				}else if(name == "index"){
+					record.index = value;
+				}else if(name == "workload"){
+					record.workload = value;
+				}else if(name == "threads"){
+					record.threads = std::stoul(value);
+				}else if(name == "operations"){
+					record.operations = std::stoull(value);
+				}else if(name == "throughput"){
+					record.throughput = std::stod(value);
+				}else if(name == "p50"){
+					record.p50 = std::stod(value);
+				}else if(name == "p90"){
+					record.p90 = std::stod(value);
+				}else if(name == "p99"){
+					record.p99 = std::stod(value);
+				}else if(name == "p999"){
+					record.p999 = std::stod(value);
+				}else if(name == "max"){
+					record.max = std::stod(value);
+				}else if(name == "memory"){
+					record.memory = std::stoull(value);
+				}
+			}catch(const std::exception&){
+				return false;
+			}
+			return true;
+		}
+
+		std::string jsonString(const std::string& text){
+
+			std::string quoted = "\"";
+			for(const char c : text){
+				if(c == '"' || c == '\\'){
+					quoted += '\\';
+				}
+				quoted += (c == '\n' || c == '\t') ? ' ' : c;
+			}
+			return quoted + "\"";
+		}
+
+		std::string csvField(const std::string& text){
+
+			if(text.find_first_of(",\"") == std::string::npos){
+				return text;
+			}
+			std::string quoted = "\"";
+			for(const char c : text){
+				if(c == '"'){
+					quoted += '"';
+				}
+				quoted += c;
+			}
+			return quoted + "\"";
+		}
+
+		bool splitCsv(const std::string& line, std::vector<std::string>& fields){
+
+			fields.assign(1, "");
+			bool quoted = false;
+
+			for(std::size_t i = 0; i < line.size(); i++){
+				const char c = line[i];
+				if(quoted){
+					if(c == '"' && i + 1 < line.size() && line[i + 1] == '"'){
+						fields.back() += '"';
+						i++;
+					}else if(c == '"'){
+						quoted = false;
+					}else{
+						fields.back() += c;
+					}
+				}else if(c == '"'){
+					quoted = true;
+				}else if(c == ','){
+					fields.emplace_back();
+				}else if(c != '\r'){
+					fields.back() += c;
+				}
+			}
+			return !quoted;
+		}
+
+		// Reads a flat object of strings and numbers, as written by ReportWriter.
+		bool parseJson(const std::string& line, BenchRecord& record){
+
+			std::size_t i = 0;
+			auto skipSpaces = [&](){
+				while(i < line.size() && std::isspace(static_cast<unsigned char>(line[i]))){
+					i++;
+				}
+			};
+			auto readString = [&](std::string& text){
+				if(i >= line.size() || line[i] != '"'){
+					return false;
+				}
+				for(i++; i < line.size() && line[i] != '"'; i++){
+					if(line[i] == '\\' && i + 1 < line.size()){
+						i++;
+					}
+					text += line[i];
+				}
+				return i++ < line.size();
+			};
+
+			skipSpaces();
+			if(i >= line.size() || line[i++] != '{'){
+				return false;
+			}
+
+			while(true){
+				skipSpaces();
+				if(i < line.size() && line[i] == '}'){
+					return true;
+				}
+
+				std::string name;
+				std::string value;
+				if(!readString(name)){
+					return false;
+				}
+				skipSpaces();
+				if(i >= line.size() || line[i++] != ':'){
+					return false;
+				}
+				skipSpaces();
+				if(i < line.size() && line[i] == '"'){
+					if(!readString(value)){
+						return false;
+					}
+				}else{
+					while(i < line.size() && line[i] != ',' && line[i] != '}' && !std::isspace(static_cast<unsigned char>(line[i]))){
+						value += line[i++];
+					}
+				}
+				if(!setField(record, name, value)){
+					return false;
+				}
+
+				skipSpaces();
+				if(i < line.size() && line[i] == ','){
+					i++;
+				}
+			}
+		}
+
+		struct Samples{
+			double mean = 0;
+			double variance = 0;	// of the mean
+			std::size_t count = 0;
+		};
+
+		Samples summarize(const std::vector<const BenchRecord*>& records, double BenchRecord::* metric){
+
+			Samples samples;
+			samples.count = records.size();
+
+			for(const BenchRecord* record : records){
+				samples.mean += record->*metric;
+			}
+			samples.mean /= samples.count;
+
+			if(samples.count > 1){
+				double squares = 0;
+				for(const BenchRecord* record : records){
+					squares += (record->*metric - samples.mean) * (record->*metric - samples.mean);
+				}
+				samples.variance = squares / (samples.count - 1) / samples.count;
+			}
+			return samples;
+		}
+
+		using Groups = std::map<std::string, std::vector<const BenchRecord*>>;
+
+		Groups groupByKey(const std::vector<BenchRecord>& records, std::vector<std::string>* order = nullptr){
+
+			Groups groups;
+			for(const BenchRecord& record : records){
+				std::vector<const BenchRecord*>& group = groups[record.key()];
+				if(group.empty() && order){
+					order->push_back(record.key());
+				}
+				group.push_back(&record);
+			}
+			return groups;
+		}
+	}
+
+	std::string BenchRecord::key() const{
+
+		std::string key = command + " " + index + " on " + dataset + ", " + std::to_string(threads) + (threads == 1 ? " thread" : " threads");
+		if(!workload.empty()){
+			key += ", " + workload;
+		}
+		return key;
+	}
+
+	std::uint64_t residentBytes(){
+
+		std::ifstream statm("/proc/self/statm");
+		std::uint64_t size = 0;
+		std::uint64_t resident = 0;
+
+		if(!(statm>>size>>resident)){
+			return 0;
+		}
+		return resident * static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+	}
+
+	std::uint64_t peakResidentBytes(){
+
+		std::ifstream status("/proc/self/status");
+		for(std::string line; std::getline(status, line); ){
+			// VmHWM:     1234 kB
+			if(line.compare(0, 6, "VmHWM:") == 0){
+				return std::stoull(line.substr(6)) * 1024;
+			}
+		}
+		return 0;
+	}
+
+	void resetPeakResident(){
+		std::ofstream("/proc/self/clear_refs")<<"5";
+	}
+
+	ReportWriter::ReportWriter(const std::string& fileName) :
+		file(fileName, std::ios::app | std::ios::ate),
+		csv(fileName.size() >= 4 && fileName.compare(fileName.size() - 4, 4, ".csv") == 0),
+		headerWritten(file.tellp() > 0)
+	{
+	}
+
+	void ReportWriter::write(const BenchRecord& record){
+
+		const std::vector<std::string> values = fieldValues(record);
+
+		if(csv){
+			if(!headerWritten){
+				for(std::size_t f = 0; f < FIELDS.size(); f++){
+					file<<(f > 0 ? "," : "")<<FIELDS[f];
+				}
+				file<<"\n";
+				headerWritten = true;
+			}
+			for(std::size_t f = 0; f < FIELDS.size(); f++){
+				file<<(f > 0 ? "," : "")<<csvField(values[f]);
+			}
+		}else{
+			file<<"{";
+			for(std::size_t f = 0; f < FIELDS.size(); f++){
+				// the first four fields are strings
+				file<<(f > 0 ? ", " : "")<<jsonString(FIELDS[f])<<": "<<(f < 4 ? jsonString(values[f]) : values[f]);
+			}
+			file<<"}";
+		}
+		file<<std::endl;
+	}
+
+	bool readReport(std::istream& in, std::vector<BenchRecord>& records, std::string& error){
+
+		std::vector<std::string> columns;
+		std::vector<std::string> fields;
+		std::string line;
+
+		for(std::size_t lineNumber = 1; std::getline(in, line); lineNumber++){
+
+			const std::size_t start = line.find_first_not_of(" \t\r");
+			if(start == std::string::npos){
+				continue;
+			}
+
+			BenchRecord record;
+
+			if(line[start] == '{'){
+				if(!parseJson(line, record)){
+					error = "line " + std::to_string(lineNumber) + ": invalid record";
+					return false;
+				}
+			}else{
+				if(!splitCsv(line, fields)){
+					error = "line " + std::to_string(lineNumber) + ": unterminated quote";
+					return false;
+				}
+				// a header, also in the middle of concatenated files
+				if(fields[0] == "command"){
+					columns = fields;
+					continue;
+				}
+				if(columns.empty() || fields.size() != columns.size()){
+					error = "line " + std::to_string(lineNumber) + ": expected " + std::to_string(columns.size()) + " columns";
+					return false;
+				}
+				for(std::size_t f = 0; f < fields.size(); f++){
+					if(!setField(record, columns[f], fields[f])){
+						error = "line " + std::to_string(lineNumber) + ": invalid " + columns[f] + " '" + fields[f] + "'";
+						return false;
+					}
+				}
+			}
+
+			records.push_back(std::move(record));
+		}
+
+		return true;
+	}
+
+	std::vector<MetricDiff> diffReports(const std::vector<BenchRecord>& baseline, const std::vector<BenchRecord>& current, const double threshold){
+
+		struct Metric{
+			const char* name;
+			double BenchRecord::* value;
+			bool higherIsBetter;
+		};
+		const Metric metrics[] = {{"throughput", &BenchRecord::throughput, true}, {"p50", &BenchRecord::p50, false}, {"p99", &BenchRecord::p99, false}};
+
+		std::vector<std::string> keys;
+		const Groups baselineGroups = groupByKey(baseline, &keys);
+		const Groups currentGroups = groupByKey(current);
+
+		std::vector<MetricDiff> diffs;
+
+		for(const std::string& key : keys){
+
+			const auto found = currentGroups.find(key);
+			if(found == currentGroups.end()){
+				continue;
+			}
+
+			for(const Metric& metric : metrics){
+
+				const Samples before = summarize(baselineGroups.at(key), metric.value);
+				const Samples after = summarize(found->second, metric.value);
+
+				// builds have no latencies
+				if(before.mean <= 0){
+					continue;
+				}
+
+				MetricDiff diff{key, metric.name, before.mean, after.mean, 0, 0, before.count, after.count, false, false};
+				diff.change = (after.mean - before.mean) / before.mean;
+				diff.noise = 2 * std::sqrt(before.variance + after.variance) / before.mean;
+
+				const double worse = metric.higherIsBetter ? -diff.change : diff.change;
+				const double limit = std::max(threshold, diff.noise);
+				diff.regression = worse > limit;
+				diff.improvement = -worse > limit;
+
+				diffs.push_back(diff);
+			}
+		}
+
+		return diffs;
+	}
+}
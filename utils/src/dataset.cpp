@@ -0,0 +1,173 @@
+#include "../headers/dataset.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace spatial {
+
+	bool IndexSlot::isBuilt() const{
+
+		if(type == "kd-tree"){
+			return kdTree.load() != nullptr;
+		}else if(type == "quad-tree"){
+			return quadTree.load() != nullptr;
+		}else if(type == "r-tree"){
+			return rTree.load() != nullptr;
+		}else if(type == "geohash"){
+			return geohash.load() != nullptr;
+		}else if(type == "aggregate-r-tree"){
+			return aggregateRTree.load() != nullptr;
+		}
+		return false;
+	}
+
+	std::shared_ptr<IndexSlot> IndexRegistry::find(const std::string& name) const{
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for(const auto& [slotName, slot] : slots){
+			if(slotName == name){
+				return slot;
+			}
+		}
+		return nullptr;
+	}
+
+	std::shared_ptr<IndexSlot> IndexRegistry::slotFor(const std::string& name, const std::string& type, const IndexParams& params) const{
+
+		const std::shared_ptr<IndexSlot> slot = find(name);
+
+		if(slot && slot->type != type){
+			throw std::invalid_argument("'" + name + "' is already a " + slot->type);
+		}
+		if(slot && slot->params == params){
+			return slot;
+		}
+		return std::make_shared<IndexSlot>(type, params);
+	}
+
+	void IndexRegistry::publish(const std::string& name, std::shared_ptr<IndexSlot> slot){
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for(auto& [slotName, registered] : slots){
+			if(slotName == name){
+				registered = std::move(slot);
+				return;
+			}
+		}
+		slots.emplace_back(name, std::move(slot));
+	}
+
+	std::string IndexRegistry::typeOf(const std::string& name) const{
+
+		if(name == "linear"){
+			return name;
+		}
+		const std::shared_ptr<IndexSlot> slot = find(name);
+		return slot ? slot->type : "";
+	}
+
+	bool IndexRegistry::isBuilt(const std::string& name) const{
+
+		if(name == "linear"){
+			return true;
+		}
+		const std::shared_ptr<IndexSlot> slot = find(name);
+		return slot && slot->isBuilt();
+	}
+
+	std::vector<std::string> IndexRegistry::available() const{
+
+		std::vector<std::string> names{"linear"};
+
+		std::lock_guard<std::mutex> lock(mutex);
+		for(const auto& [name, slot] : slots){
+			if(slot->isBuilt()){
+				names.push_back(name);
+			}
+		}
+		return names;
+	}
+
+	void IndexRegistry::recordHeapGrowth(const std::string& name, const std::uint64_t bytes){
+
+		std::lock_guard<std::mutex> lock(mutex);
+		heapGrowths[name] = bytes;
+	}
+
+	std::uint64_t IndexRegistry::heapGrowth(const std::string& name) const{
+
+		std::lock_guard<std::mutex> lock(mutex);
+		const auto it = heapGrowths.find(name);
+		return it != heapGrowths.end() ? it->second : 0;
+	}
+
+	Dataset::Dataset(std::string name, std::vector<std::shared_ptr<geos::geom::Geometry>> geometries, std::size_t preparedCacheCapacity, AttributeTable attributes) :
+		name(std::move(name)),
+		geometries(std::move(geometries)),
+		attributes(std::move(attributes)),
+		minX(std::numeric_limits<double>::max()),
+		minY(std::numeric_limits<double>::max()),
+		maxX(std::numeric_limits<double>::lowest()),
+		maxY(std::numeric_limits<double>::lowest())
+	{
+		for(const auto& geom : this->geometries){
+			const geos::geom::Envelope* envelope = geom->getEnvelopeInternal();
+			if(envelope && !envelope->isNull()){
+				minX = std::min(minX, envelope->getMinX());
+				minY = std::min(minY, envelope->getMinY());
+				maxX = std::max(maxX, envelope->getMaxX());
+				maxY = std::max(maxY, envelope->getMaxY());
+			}
+		}
+
+		envelopeTable.build(this->geometries);
+		preparedCache = std::make_unique<PreparedGeometryCache>(this->geometries.size(), preparedCacheCapacity);
+	}
+
+	std::vector<const geos::geom::Envelope*> Dataset::envelopes() const{
+
+		std::vector<const geos::geom::Envelope*> envelopes(geometries.size());
+
+		for(std::size_t i = 0; i < geometries.size(); i++){
+			envelopes[i] = geometries[i]->getEnvelopeInternal();
+		}
+
+		return envelopes;
+	}
+
+	void DatasetRegistry::put(std::shared_ptr<Dataset> dataset, bool activate){
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if(activate || active.empty()){
+			active = dataset->name;
+		}
+		const std::string name = dataset->name;
+		datasets[name] = std::move(dataset);
+	}
+
+	std::shared_ptr<Dataset> DatasetRegistry::get(const std::string& name) const{
+
+		std::lock_guard<std::mutex> lock(mutex);
+		const auto it = datasets.find(name.empty() ? active : name);
+		return it != datasets.end() ? it->second : nullptr;
+	}
+
+	std::vector<std::shared_ptr<Dataset>> DatasetRegistry::list() const{
+
+		std::lock_guard<std::mutex> lock(mutex);
+		std::vector<std::shared_ptr<Dataset>> result;
+		for(const auto& [name, dataset] : datasets){
+			result.push_back(dataset);
+		}
+		return result;
+	}
+
+	std::string DatasetRegistry::activeName() const{
+
+		std::lock_guard<std::mutex> lock(mutex);
+		return active;
+	}
+}
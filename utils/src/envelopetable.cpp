@@ -0,0 +1,261 @@
+#include "../headers/envelopetable.h"
+
+#include <cstdlib>
+#include <limits>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ENVELOPETABLE_X86
+#endif
+
+namespace spatial {
+
+	namespace {
+
+		struct Columns{
+			const double* minX;
+			const double* minY;
+			const double* maxX;
+			const double* maxY;
+		};
+
+		struct Query{
+			double minX;
+			double minY;
+			double maxX;
+			double maxY;
+		};
+
+		Query toQuery(const geos::geom::Envelope& envelope){
+			if(envelope.isNull()){
+				constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+				return {nan, nan, nan, nan};
+			}
+			return {envelope.getMinX(), envelope.getMinY(), envelope.getMaxX(), envelope.getMaxY()};
+		}
+
+		// Comparisons are written so that a NaN (null envelope) never matches.
+		template<EnvelopePredicate P>
+		inline bool test(const Columns& c, const std::size_t i, const Query& q){
+			if constexpr (P == EnvelopePredicate::contains){
+				return c.minX[i] >= q.minX && c.maxX[i] <= q.maxX && c.minY[i] >= q.minY && c.maxY[i] <= q.maxY;
+			}else{
+				return c.minX[i] <= q.maxX && c.maxX[i] >= q.minX && c.minY[i] <= q.maxY && c.maxY[i] >= q.minY;
+			}
+		}
+
+		template<EnvelopePredicate P>
+		void selectRangeScalar(const Columns& c, std::size_t i, const std::size_t count, const Query& q, std::uint64_t* selection){
+			for(; i < count; i++){
+				if(i % 64 == 0){
+					selection[i/64] = 0;
+				}
+				selection[i/64] |= std::uint64_t(test<P>(c, i, q)) << (i % 64);
+			}
+		}
+
+		template<EnvelopePredicate P>
+		std::uint64_t selectIdsScalar(const Columns& c, const std::size_t* ids, std::size_t j, const std::size_t count, const Query& q){
+			std::uint64_t selection = 0;
+			for(; j < count; j++){
+				selection |= std::uint64_t(test<P>(c, ids[j], q)) << j;
+			}
+			return selection;
+		}
+
+#ifdef ENVELOPETABLE_X86
+
+		template<EnvelopePredicate P>
+		__attribute__((target("avx2")))
+		inline __m256d test4(const __m256d minX, const __m256d minY, const __m256d maxX, const __m256d maxY, const Query& q){
+			if constexpr (P == EnvelopePredicate::contains){
+				return _mm256_and_pd(
+					_mm256_and_pd(_mm256_cmp_pd(minX, _mm256_set1_pd(q.minX), _CMP_GE_OQ), _mm256_cmp_pd(maxX, _mm256_set1_pd(q.maxX), _CMP_LE_OQ)),
+					_mm256_and_pd(_mm256_cmp_pd(minY, _mm256_set1_pd(q.minY), _CMP_GE_OQ), _mm256_cmp_pd(maxY, _mm256_set1_pd(q.maxY), _CMP_LE_OQ)));
+			}else{
+				return _mm256_and_pd(
+					_mm256_and_pd(_mm256_cmp_pd(minX, _mm256_set1_pd(q.maxX), _CMP_LE_OQ), _mm256_cmp_pd(maxX, _mm256_set1_pd(q.minX), _CMP_GE_OQ)),
+					_mm256_and_pd(_mm256_cmp_pd(minY, _mm256_set1_pd(q.maxY), _CMP_LE_OQ), _mm256_cmp_pd(maxY, _mm256_set1_pd(q.minY), _CMP_GE_OQ)));
+			}
+		}
+
+		template<EnvelopePredicate P>
+		__attribute__((target("avx2")))
+		void selectRangeAvx2(const Columns& c, const std::size_t count, const Query& q, std::uint64_t* selection){
+			std::size_t i = 0;
+			for(; i + 64 <= count; i += 64){
+				std::uint64_t bits = 0;
+				for(std::size_t j = 0; j < 64; j += 4){
+					const __m256d match = test4<P>(_mm256_loadu_pd(c.minX + i + j), _mm256_loadu_pd(c.minY + i + j),
+												   _mm256_loadu_pd(c.maxX + i + j), _mm256_loadu_pd(c.maxY + i + j), q);
+					bits |= std::uint64_t(_mm256_movemask_pd(match)) << j;
+				}
+				selection[i/64] = bits;
+			}
+			selectRangeScalar<P>(c, i, count, q, selection);
+		}
+
+		template<EnvelopePredicate P>
+		__attribute__((target("avx2")))
+		std::uint64_t selectIdsAvx2(const Columns& c, const std::size_t* ids, const std::size_t count, const Query& q){
+			std::uint64_t bits = 0;
+			std::size_t j = 0;
+			for(; j + 4 <= count; j += 4){
+				const __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ids + j));
+				const __m256d match = test4<P>(_mm256_i64gather_pd(c.minX, idx, 8), _mm256_i64gather_pd(c.minY, idx, 8),
+											   _mm256_i64gather_pd(c.maxX, idx, 8), _mm256_i64gather_pd(c.maxY, idx, 8), q);
+				bits |= std::uint64_t(_mm256_movemask_pd(match)) << j;
+			}
+			return bits | selectIdsScalar<P>(c, ids, j, count, q);
+		}
+
+		template<EnvelopePredicate P>
+		__attribute__((target("avx512f")))
+		inline __mmask8 test8(const __m512d minX, const __m512d minY, const __m512d maxX, const __m512d maxY, const Query& q){
+			if constexpr (P == EnvelopePredicate::contains){
+				return _mm512_cmp_pd_mask(minX, _mm512_set1_pd(q.minX), _CMP_GE_OQ) & _mm512_cmp_pd_mask(maxX, _mm512_set1_pd(q.maxX), _CMP_LE_OQ)
+					 & _mm512_cmp_pd_mask(minY, _mm512_set1_pd(q.minY), _CMP_GE_OQ) & _mm512_cmp_pd_mask(maxY, _mm512_set1_pd(q.maxY), _CMP_LE_OQ);
+			}else{
+				return _mm512_cmp_pd_mask(minX, _mm512_set1_pd(q.maxX), _CMP_LE_OQ) & _mm512_cmp_pd_mask(maxX, _mm512_set1_pd(q.minX), _CMP_GE_OQ)
+					 & _mm512_cmp_pd_mask(minY, _mm512_set1_pd(q.maxY), _CMP_LE_OQ) & _mm512_cmp_pd_mask(maxY, _mm512_set1_pd(q.minY), _CMP_GE_OQ);
+			}
+		}
+
+		template<EnvelopePredicate P>
+		__attribute__((target("avx512f")))
+		void selectRangeAvx512(const Columns& c, const std::size_t count, const Query& q, std::uint64_t* selection){
+			std::size_t i = 0;
+			for(; i + 64 <= count; i += 64){
+				std::uint64_t bits = 0;
+				for(std::size_t j = 0; j < 64; j += 8){
+					const __mmask8 match = test8<P>(_mm512_loadu_pd(c.minX + i + j), _mm512_loadu_pd(c.minY + i + j),
+													_mm512_loadu_pd(c.maxX + i + j), _mm512_loadu_pd(c.maxY + i + j), q);
+					bits |= std::uint64_t(match) << j;
+				}
+				selection[i/64] = bits;
+			}
+			selectRangeScalar<P>(c, i, count, q, selection);
+		}
+
+		template<EnvelopePredicate P>
+		__attribute__((target("avx512f")))
+		std::uint64_t selectIdsAvx512(const Columns& c, const std::size_t* ids, const std::size_t count, const Query& q){
+			std::uint64_t bits = 0;
+			std::size_t j = 0;
+			for(; j + 8 <= count; j += 8){
+				const __m512i idx = _mm512_loadu_si512(ids + j);
+				const __mmask8 match = test8<P>(_mm512_i64gather_pd(idx, c.minX, 8), _mm512_i64gather_pd(idx, c.minY, 8),
+												_mm512_i64gather_pd(idx, c.maxX, 8), _mm512_i64gather_pd(idx, c.maxY, 8), q);
+				bits |= std::uint64_t(match) << j;
+			}
+			return bits | selectIdsScalar<P>(c, ids, j, count, q);
+		}
+
+#endif
+
+		struct Kernels{
+			const char* name;
+			void (*selectRangeContains)(const Columns&, std::size_t, const Query&, std::uint64_t*);
+			void (*selectRangeIntersects)(const Columns&, std::size_t, const Query&, std::uint64_t*);
+			std::uint64_t (*selectIdsContains)(const Columns&, const std::size_t*, std::size_t, const Query&);
+			std::uint64_t (*selectIdsIntersects)(const Columns&, const std::size_t*, std::size_t, const Query&);
+		};
+
+		template<EnvelopePredicate P>
+		void selectRangeScalarFrom0(const Columns& c, const std::size_t count, const Query& q, std::uint64_t* selection){
+			selectRangeScalar<P>(c, 0, count, q, selection);
+		}
+
+		template<EnvelopePredicate P>
+		std::uint64_t selectIdsScalarFrom0(const Columns& c, const std::size_t* ids, const std::size_t count, const Query& q){
+			return selectIdsScalar<P>(c, ids, 0, count, q);
+		}
+
+		// The widest kernel the cpu runs, or the one named by SPATIAL_KERNEL
+		// when the cpu runs it, to compare them.
+		Kernels chooseKernels(){
+
+			const char* variable = std::getenv("SPATIAL_KERNEL");
+			const std::string_view requested = variable ? variable : "";
+
+			const Kernels scalar{"scalar",
+					selectRangeScalarFrom0<EnvelopePredicate::contains>, selectRangeScalarFrom0<EnvelopePredicate::intersects>,
+					selectIdsScalarFrom0<EnvelopePredicate::contains>, selectIdsScalarFrom0<EnvelopePredicate::intersects>};
+
+			if(requested == "scalar"){
+				return scalar;
+			}
+#ifdef ENVELOPETABLE_X86
+			static_assert(sizeof(std::size_t) == sizeof(long long), "gather kernels expect 64-bit ids");
+
+			if(__builtin_cpu_supports("avx512f") && requested != "avx2"){
+				return {"avx512",
+						selectRangeAvx512<EnvelopePredicate::contains>, selectRangeAvx512<EnvelopePredicate::intersects>,
+						selectIdsAvx512<EnvelopePredicate::contains>, selectIdsAvx512<EnvelopePredicate::intersects>};
+			}
+			if(__builtin_cpu_supports("avx2")){
+				return {"avx2",
+						selectRangeAvx2<EnvelopePredicate::contains>, selectRangeAvx2<EnvelopePredicate::intersects>,
+						selectIdsAvx2<EnvelopePredicate::contains>, selectIdsAvx2<EnvelopePredicate::intersects>};
+			}
+#endif
+			return scalar;
+		}
+
+		const Kernels& kernels(){
+			static const Kernels chosen = chooseKernels();
+			return chosen;
+		}
+	}
+
+	void EnvelopeTable::build(const std::vector<std::shared_ptr<geos::geom::Geometry>>& geometries){
+
+		clear();
+
+		minX.reserve(geometries.size());
+		minY.reserve(geometries.size());
+		maxX.reserve(geometries.size());
+		maxY.reserve(geometries.size());
+
+		for(const auto& geom : geometries){
+			const Query envelope = toQuery(geom ? *geom->getEnvelopeInternal() : geos::geom::Envelope());
+			minX.push_back(envelope.minX);
+			minY.push_back(envelope.minY);
+			maxX.push_back(envelope.maxX);
+			maxY.push_back(envelope.maxY);
+		}
+	}
+
+	void EnvelopeTable::clear(){
+		minX.clear();
+		minY.clear();
+		maxX.clear();
+		maxY.clear();
+	}
+
+	const char* EnvelopeTable::kernelName(){
+		return kernels().name;
+	}
+
+	void EnvelopeTable::select(EnvelopePredicate predicate, const geos::geom::Envelope& query, std::size_t begin, std::size_t count, std::uint64_t* selection) const{
+
+		const Columns columns{minX.data() + begin, minY.data() + begin, maxX.data() + begin, maxY.data() + begin};
+
+		if(predicate == EnvelopePredicate::contains){
+			kernels().selectRangeContains(columns, count, toQuery(query), selection);
+		}else{
+			kernels().selectRangeIntersects(columns, count, toQuery(query), selection);
+		}
+	}
+
+	std::uint64_t EnvelopeTable::select(EnvelopePredicate predicate, const geos::geom::Envelope& query, const std::size_t* ids, std::size_t count) const{
+
+		const Columns columns{minX.data(), minY.data(), maxX.data(), maxY.data()};
+
+		if(predicate == EnvelopePredicate::contains){
+			return kernels().selectIdsContains(columns, ids, count, toQuery(query));
+		}
+		return kernels().selectIdsIntersects(columns, ids, count, toQuery(query));
+	}
+}
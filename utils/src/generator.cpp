@@ -0,0 +1,311 @@
+#include "../headers/generator.h"
+#include "../headers/threadpool.h"
+
+#include <geos/geom/CoordinateSequence.h>
+#include <geos/geom/GeometryFactory.h>
+#include <geos/geom/LinearRing.h>
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+namespace spatial {
+
+	namespace {
+
+		constexpr std::size_t BLOCK_SIZE = 16384;
+		constexpr double ROAD_STEP = 1.0 / 200;		// length of a road segment, relative to the extent
+		constexpr std::size_t ROAD_SEGMENTS = 200;
+
+		const char* kindNames[] = {"points", "lines", "polygons"};
+		const char* layoutNames[] = {"uniform", "clusters", "roads", "overlapping"};
+
+		using Road = std::vector<geos::geom::CoordinateXY>;
+
+		struct Cluster{
+			double x, y, spread;
+		};
+
+		// A feature position with the direction lines start in.
+		struct Placement{
+			double x, y, heading;
+			const Road* road = nullptr;
+			std::size_t segment = 0;
+			double along = 0;		// position on the segment, in [0, 1]
+		};
+
+		class LayerGenerator{
+		public:
+			explicit LayerGenerator(const LayerSpec& spec) :
+				spec(spec),
+				factory(geos::geom::GeometryFactory::getDefaultInstance())
+			{
+				std::mt19937_64 engine(spec.seed);
+				std::uniform_real_distribution<double> coordinate(0, spec.extent);
+
+				if(spec.layout == Layout::clusters){
+					// a few large clusters and many small ones
+					std::uniform_real_distribution<double> spreadFactor(0.5, 2);
+					double weights = 0;
+					for(std::size_t c = 0; c < std::max<std::size_t>(spec.clusters, 1); c++){
+						clusters.push_back({coordinate(engine), coordinate(engine), spec.spread * spec.extent * spreadFactor(engine)});
+						weights += 1.0 / (c + 1);
+						clusterWeights.push_back(weights);
+					}
+				}
+
+				if(spec.layout == Layout::roads){
+					const std::size_t roadCount = std::clamp<std::size_t>(spec.count / 1000, 8, 4096);
+					for(std::size_t r = 0; r < roadCount; r++){
+						roads.push_back(makeRoad(engine));
+					}
+				}
+
+				baseSize = spec.size * spec.extent;
+				if(spec.layout == Layout::overlapping){
+					// discs of diameter d overlap when their centres are closer than d
+					baseSize = spec.extent * std::sqrt(spec.overlap / (std::numbers::pi * std::max<std::size_t>(spec.count, 1)));
+				}
+			}
+
+			// Makes the features [begin, end) with an engine of their own.
+			void generate(const std::size_t block, const std::size_t begin, const std::size_t end, std::vector<std::shared_ptr<geos::geom::Geometry>>& geometries, std::vector<double>& sizes) const{
+
+				std::mt19937_64 engine(spec.seed + 0x9E3779B97F4A7C15ull * (block + 1));
+				std::normal_distribution<double> normal;
+
+				for(std::size_t i = begin; i < end; i++){
+
+					const double size = baseSize * (spec.skew > 0 ? std::exp(spec.skew * normal(engine) - spec.skew * spec.skew / 2) : 1.0);
+					const Placement placement = place(engine, size);
+
+					sizes[i] = size;
+					switch(spec.kind){
+					case FeatureKind::points:
+						geometries[i] = factory->createPoint(geos::geom::CoordinateXY(placement.x, placement.y));
+						break;
+					case FeatureKind::lines:
+						geometries[i] = makeLine(engine, placement, size);
+						break;
+					case FeatureKind::polygons:
+						geometries[i] = makePolygon(engine, placement, size);
+						break;
+					}
+				}
+			}
+
+		private:
+			// A winding road crossing the extent, turned back at the borders.
+			Road makeRoad(std::mt19937_64& engine) const{
+
+				std::uniform_real_distribution<double> coordinate(0, spec.extent);
+				std::uniform_real_distribution<double> angle(0, 2 * std::numbers::pi);
+				std::normal_distribution<double> turn(0, 0.15);
+
+				const double step = ROAD_STEP * spec.extent;
+				double x = coordinate(engine);
+				double y = coordinate(engine);
+				double heading = angle(engine);
+
+				Road road{{x, y}};
+				for(std::size_t s = 0; s < ROAD_SEGMENTS; s++){
+					heading += turn(engine);
+					double nextX = x + step * std::cos(heading);
+					double nextY = y + step * std::sin(heading);
+					if(nextX < 0 || nextX > spec.extent || nextY < 0 || nextY > spec.extent){
+						heading += std::numbers::pi;
+						nextX = std::clamp(x + step * std::cos(heading), 0.0, spec.extent);
+						nextY = std::clamp(y + step * std::sin(heading), 0.0, spec.extent);
+					}
+					x = nextX;
+					y = nextY;
+					road.push_back({x, y});
+				}
+				return road;
+			}
+
+			Placement place(std::mt19937_64& engine, const double size) const{
+
+				std::uniform_real_distribution<double> unit(0, 1);
+				const double heading = unit(engine) * 2 * std::numbers::pi;
+
+				switch(spec.layout){
+				case Layout::clusters:{
+					const double weight = unit(engine) * clusterWeights.back();
+					const std::size_t c = std::upper_bound(clusterWeights.begin(), clusterWeights.end(), weight) - clusterWeights.begin();
+					const Cluster& cluster = clusters[std::min(c, clusters.size() - 1)];
+					std::normal_distribution<double> offset(0, cluster.spread);
+					return {std::clamp(cluster.x + offset(engine), 0.0, spec.extent), std::clamp(cluster.y + offset(engine), 0.0, spec.extent), heading};
+				}
+				case Layout::roads:{
+					const Road& road = roads[static_cast<std::size_t>(unit(engine) * roads.size()) % roads.size()];
+					const std::size_t segment = static_cast<std::size_t>(unit(engine) * (road.size() - 1)) % (road.size() - 1);
+					const double along = unit(engine);
+
+					const geos::geom::CoordinateXY& a = road[segment];
+					const geos::geom::CoordinateXY& b = road[segment + 1];
+					const double roadHeading = std::atan2(b.y - a.y, b.x - a.x);
+
+					// points and lines on the road, polygons beside it
+					const double side = spec.kind == FeatureKind::polygons ? (unit(engine) < 0.5 ? -1 : 1) * size : 0;
+					const double x = a.x + (b.x - a.x) * along - side * std::sin(roadHeading);
+					const double y = a.y + (b.y - a.y) * along + side * std::cos(roadHeading);
+
+					return {x, y, roadHeading, &road, segment, along};
+				}
+				default:
+					return {unit(engine) * spec.extent, unit(engine) * spec.extent, heading};
+				}
+			}
+
+			std::shared_ptr<geos::geom::Geometry> makeLine(std::mt19937_64& engine, const Placement& placement, const double length) const{
+
+				auto coords = std::make_unique<geos::geom::CoordinateSequence>();
+				coords->add(geos::geom::Coordinate(placement.x, placement.y));
+
+				if(placement.road){
+					// follows the road for the length of the line
+					const Road& road = *placement.road;
+					double left = length;
+					std::size_t segment = placement.segment;
+					double along = placement.along;
+
+					while(left > 0 && segment + 1 < road.size()){
+						const geos::geom::CoordinateXY& a = road[segment];
+						const geos::geom::CoordinateXY& b = road[segment + 1];
+						const double segmentLength = a.distance(b);
+						const double available = segmentLength * (1 - along);
+
+						if(segmentLength > 0 && available > left){
+							along += left / segmentLength;
+							coords->add(geos::geom::Coordinate(a.x + (b.x - a.x) * along, a.y + (b.y - a.y) * along));
+							left = 0;
+						}else{
+							coords->add(geos::geom::Coordinate(b.x, b.y));
+							left -= available;
+							segment++;
+							along = 0;
+						}
+					}
+					if(coords->size() < 2){
+						coords->add(geos::geom::Coordinate(placement.x + length * std::cos(placement.heading), placement.y + length * std::sin(placement.heading)));
+					}
+				}else{
+					std::normal_distribution<double> turn(0, 0.5);
+					constexpr std::size_t SEGMENTS = 3;
+					double x = placement.x;
+					double y = placement.y;
+					double heading = placement.heading;
+					for(std::size_t s = 0; s < SEGMENTS; s++){
+						x += length / SEGMENTS * std::cos(heading);
+						y += length / SEGMENTS * std::sin(heading);
+						coords->add(geos::geom::Coordinate(x, y));
+						heading += turn(engine);
+					}
+				}
+
+				return factory->createLineString(std::move(coords));
+			}
+
+			// A star-shaped polygon around the placement, simple by construction.
+			std::shared_ptr<geos::geom::Geometry> makePolygon(std::mt19937_64& engine, const Placement& placement, const double diameter) const{
+
+				std::uniform_int_distribution<std::size_t> vertexCount(5, 10);
+				std::uniform_real_distribution<double> unit(0, 1);
+
+				const std::size_t vertices = vertexCount(engine);
+				const double spacing = 2 * std::numbers::pi / vertices;
+
+				auto coords = std::make_unique<geos::geom::CoordinateSequence>();
+				for(std::size_t v = 0; v < vertices; v++){
+					const double angle = placement.heading + spacing * (v + 0.8 * unit(engine) - 0.4);
+					const double radius = diameter / 2 * (0.6 + 0.4 * unit(engine));
+					coords->add(geos::geom::Coordinate(placement.x + radius * std::cos(angle), placement.y + radius * std::sin(angle)));
+				}
+				coords->closeRing();
+
+				return factory->createPolygon(factory->createLinearRing(std::move(coords)));
+			}
+
+			const LayerSpec& spec;
+			const geos::geom::GeometryFactory* factory;
+			std::vector<Cluster> clusters;
+			std::vector<double> clusterWeights;	// cumulative, the weight of cluster c is 1 / (c + 1)
+			std::vector<Road> roads;
+			double baseSize;
+		};
+	}
+
+	bool parseFeatureKind(const std::string& name, FeatureKind& kind){
+
+		for(std::size_t k = 0; k < std::size(kindNames); k++){
+			if(name == kindNames[k]){
+				kind = static_cast<FeatureKind>(k);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool parseLayout(const std::string& name, Layout& layout){
+
+		for(std::size_t l = 0; l < std::size(layoutNames); l++){
+			if(name == layoutNames[l]){
+				layout = static_cast<Layout>(l);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	std::string describe(const LayerSpec& spec){
+
+		std::ostringstream oss;
+		oss<<spec.count<<" "<<kindNames[static_cast<std::size_t>(spec.kind)]<<" layout="<<layoutNames[static_cast<std::size_t>(spec.layout)]<<" seed="<<spec.seed;
+		if(spec.layout == Layout::clusters){
+			oss<<" clusters="<<spec.clusters<<" spread="<<spec.spread;
+		}
+		if(spec.kind != FeatureKind::points){
+			if(spec.layout == Layout::overlapping){
+				oss<<" overlap="<<spec.overlap;
+			}else{
+				oss<<" size="<<spec.size;
+			}
+			if(spec.skew > 0){
+				oss<<" skew="<<spec.skew;
+			}
+		}
+		return oss.str();
+	}
+
+	std::vector<std::shared_ptr<geos::geom::Geometry>> generateLayer(const LayerSpec& spec, AttributeTable& attributes, ThreadPool* pool){
+
+		if(spec.layout == Layout::overlapping && spec.kind == FeatureKind::points){
+			throw std::invalid_argument("the overlapping layout needs lines or polygons");
+		}
+
+		const LayerGenerator generator(spec);
+		std::vector<std::shared_ptr<geos::geom::Geometry>> geometries(spec.count);
+		std::vector<double> sizes(spec.count);
+
+		const std::size_t blocks = (spec.count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		auto generateBlock = [&](std::size_t, const std::size_t block){
+			generator.generate(block, block * BLOCK_SIZE, std::min(spec.count, (block + 1) * BLOCK_SIZE), geometries, sizes);
+		};
+
+		if(pool){
+			pool->parallelFor(blocks, 1, generateBlock);
+		}else{
+			for(std::size_t block = 0; block < blocks; block++){
+				generateBlock(0, block);
+			}
+		}
+
+		attributes.names = {"size"};
+		attributes.columns = {std::move(sizes)};
+
+		return geometries;
+	}
+}
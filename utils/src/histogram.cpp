@@ -0,0 +1,99 @@
+#include "../headers/histogram.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <ostream>
+
+namespace spatial {
+
+	namespace {
+
+		constexpr std::uint64_t SUB_BUCKETS = std::uint64_t(1) << LatencyHistogram::SUB_BUCKET_BITS;
+		constexpr std::uint64_t HALF = SUB_BUCKETS / 2;
+	}
+
+	// Values below SUB_BUCKETS are their own bucket. A larger value with its
+	// highest bit at position m keeps its top SUB_BUCKET_BITS bits, which lie
+	// in [HALF, SUB_BUCKETS): HALF buckets per power of two.
+	std::size_t LatencyHistogram::bucketOf(const std::uint64_t value){
+
+		if(value < SUB_BUCKETS){
+			return value;
+		}
+		const unsigned magnitude = std::bit_width(value) - 1;
+		const unsigned shift = magnitude - (SUB_BUCKET_BITS - 1);
+		return SUB_BUCKETS + (magnitude - SUB_BUCKET_BITS) * HALF + ((value >> shift) - HALF);
+	}
+
+	std::uint64_t LatencyHistogram::lowestOf(const std::size_t bucket){
+
+		if(bucket < SUB_BUCKETS){
+			return bucket;
+		}
+		const std::size_t magnitude = (bucket - SUB_BUCKETS) / HALF + SUB_BUCKET_BITS;
+		const std::uint64_t top = (bucket - SUB_BUCKETS) % HALF + HALF;
+		return top << (magnitude - (SUB_BUCKET_BITS - 1));
+	}
+
+	std::uint64_t LatencyHistogram::highestOf(const std::size_t bucket){
+
+		if(bucket + 1 == BUCKETS){
+			return UINT64_MAX;
+		}
+		return lowestOf(bucket + 1) - 1;
+	}
+
+	void LatencyHistogram::record(const std::uint64_t value){
+		counts[bucketOf(value)]++;
+		total++;
+		maximum = std::max(maximum, value);
+		sum += value;
+	}
+
+	void LatencyHistogram::merge(const LatencyHistogram& other){
+		for(std::size_t b = 0; b < BUCKETS; b++){
+			counts[b] += other.counts[b];
+		}
+		total += other.total;
+		maximum = std::max(maximum, other.maximum);
+		sum += other.sum;
+	}
+
+	void LatencyHistogram::clear(){
+		counts.fill(0);
+		total = 0;
+		maximum = 0;
+		sum = 0;
+	}
+
+	double LatencyHistogram::mean() const{
+		return total == 0 ? 0.0 : static_cast<double>(sum / total);
+	}
+
+	std::uint64_t LatencyHistogram::percentile(const double quantile) const{
+
+		if(total == 0){
+			return 0;
+		}
+
+		const std::uint64_t rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(std::clamp(quantile, 0.0, 1.0) * total)));
+
+		std::uint64_t seen = 0;
+		for(std::size_t b = 0; b < BUCKETS; b++){
+			seen += counts[b];
+			if(seen >= rank){
+				return std::min(highestOf(b), maximum);
+			}
+		}
+		return maximum;
+	}
+
+	void LatencyHistogram::dump(std::ostream& out) const{
+		for(std::size_t b = 0; b < BUCKETS; b++){
+			if(counts[b] > 0){
+				out<<lowestOf(b)<<" "<<std::min(highestOf(b), maximum)<<" "<<counts[b]<<"\n";
+			}
+		}
+	}
+}
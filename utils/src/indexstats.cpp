@@ -0,0 +1,236 @@
+#include "../headers/indexstats.h"
+
+#include <geos/index/kdtree/KdNode.h>
+#include <geos/index/strtree/AbstractNode.h>
+#include <geos/index/strtree/ItemBoundable.h>
+#include <malloc.h>
+#include <algorithm>
+
+namespace spatial {
+
+	namespace {
+
+		// Sums the pairwise intersections of sibling envelopes and their areas.
+		struct OverlapSum{
+			double shared = 0;
+			double area = 0;
+
+			void add(const std::vector<const geos::geom::Envelope*>& siblings){
+				for(std::size_t a = 0; a < siblings.size(); a++){
+					area += siblings[a]->getArea();
+					for(std::size_t b = a + 1; b < siblings.size(); b++){
+						geos::geom::Envelope intersection;
+						if(siblings[a]->intersection(*siblings[b], intersection)){
+							shared += intersection.getArea();
+						}
+					}
+				}
+			}
+
+			double ratio() const{
+				return area > 0 ? shared / area : 0;
+			}
+		};
+
+		struct TreeWalk{
+			std::uint64_t inner = 0;
+			std::uint64_t innerChildren = 0;
+			std::uint64_t leaves = 0;
+			std::uint64_t entries = 0;
+			std::size_t depth = 0;
+			OverlapSum overlap;
+
+			void finish(IndexStats& stats, const std::size_t capacity) const{
+				stats.nodes = inner + leaves;
+				stats.leaves = leaves;
+				stats.depth = depth;
+				stats.fanout = inner > 0 ? static_cast<double>(innerChildren) / inner : 0;
+				stats.occupancy = leaves > 0 ? static_cast<double>(entries) / (leaves * capacity) : 0;
+				stats.overlap = overlap.ratio();
+			}
+		};
+
+		void walkStrNode(geos::index::strtree::AbstractNode* node, const std::size_t level, TreeWalk& walk){
+
+			walk.depth = std::max(walk.depth, level);
+			std::vector<const geos::geom::Envelope*> children;
+
+			for(geos::index::strtree::Boundable* child : *node->getChildBoundables()){
+				if(auto* childNode = dynamic_cast<geos::index::strtree::AbstractNode*>(child)){
+					children.push_back(static_cast<const geos::geom::Envelope*>(childNode->getBounds()));
+					walkStrNode(childNode, level + 1, walk);
+				}else{
+					walk.entries++;
+				}
+			}
+
+			if(children.empty()){
+				walk.leaves++;
+			}else{
+				walk.inner++;
+				walk.innerChildren += children.size();
+				walk.overlap.add(children);
+			}
+		}
+
+		// requested bytes and allocator overhead of count allocations of size bytes
+		void addAllocations(std::uint64_t& requested, std::uint64_t& overhead, const std::uint64_t count, const std::uint64_t bytes){
+			requested += count * bytes;
+			overhead += count * (allocationSize(bytes) - bytes);
+		}
+	}
+
+	std::uint64_t heapInUse(){
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+		const struct mallinfo2 info = mallinfo2();
+		return info.uordblks + info.hblkhd;
+#else
+		return 0;
+#endif
+	}
+
+	std::uint64_t allocationSize(const std::uint64_t bytes){
+		// 8 bytes of header, 16 bytes alignment, 32 bytes at least
+		return std::max<std::uint64_t>(32, (bytes + 8 + 15) & ~std::uint64_t(15));
+	}
+
+	IndexStats kdTreeStats(geos::index::kdtree::KdTree& tree){
+
+		IndexStats stats;
+		stats.entries = tree.size();
+		stats.nodes = stats.entries;
+		stats.depth = tree.depth();
+		stats.fanout = 2;
+		// the nodes are kept in a std::deque, in blocks with little overhead
+		stats.nodeBytes = stats.entries * sizeof(geos::index::kdtree::KdNode);
+		stats.note = "one node per distinct point, the leaves are not told apart";
+		return stats;
+	}
+
+	IndexStats quadTreeStats(ShardedIndex<geos::index::quadtree::Quadtree>& index){
+
+		IndexStats stats;
+		index.forEachShard([&stats](const geos::geom::Envelope&, geos::index::quadtree::Quadtree& tree){
+			stats.entries += tree.size();
+			stats.depth = std::max(stats.depth, tree.depth());
+		});
+
+		// every node keeps its items in a vector of pointers
+		stats.itemBytes = stats.entries * sizeof(void*);
+		stats.note = "GEOS keeps the quadtree nodes private, they only show in the heap growth of the build";
+		return stats;
+	}
+
+	IndexStats rTreeStats(ShardedIndex<geos::index::strtree::STRtree>& index){
+
+		IndexStats stats;
+		TreeWalk walk;
+		std::size_t capacity = 0;
+		std::vector<const geos::geom::Envelope*> shardExtents;
+
+		index.forEachShard([&](const geos::geom::Envelope& extent, geos::index::strtree::STRtree& tree){
+			capacity = tree.getNodeCapacity();
+			shardExtents.push_back(&extent);
+			if(geos::index::strtree::AbstractNode* root = tree.getRoot()){
+				walkStrNode(root, 1, walk);
+			}
+		});
+
+		// the shard extents are the merged root level
+		if(shardExtents.size() > 1){
+			walk.overlap.add(shardExtents);
+		}
+
+		walk.finish(stats, std::max<std::size_t>(capacity, 1));
+		stats.entries = walk.entries;
+
+		// estimated from the GEOS layout: a node with its child list reserved
+		// to the capacity and its bounds, an ItemBoundable per item listed in
+		// the tree and in its leaf
+		addAllocations(stats.nodeBytes, stats.overheadBytes, stats.nodes, sizeof(geos::index::strtree::AbstractNode));
+		addAllocations(stats.nodeBytes, stats.overheadBytes, stats.nodes, capacity * sizeof(void*));
+		addAllocations(stats.nodeBytes, stats.overheadBytes, stats.nodes, sizeof(geos::geom::Envelope));
+		addAllocations(stats.itemBytes, stats.overheadBytes, stats.entries, sizeof(geos::index::strtree::ItemBoundable));
+		stats.itemBytes += stats.entries * 2 * sizeof(void*);
+
+		return stats;
+	}
+
+	IndexStats geohashStats(const GeohashIndex& index){
+
+		IndexStats stats;
+		stats.entries = index.size();
+
+		std::size_t precision = 0;
+		for(const auto& [hash, id] : index){
+			// strings longer than the small string buffer go to the heap
+			if(hash.capacity() > std::string().capacity()){
+				addAllocations(stats.keyBytes, stats.overheadBytes, 1, hash.capacity() + 1);
+			}
+			precision = std::max(precision, hash.size());
+		}
+
+		stats.keyBytes += stats.entries * sizeof(std::string);
+		stats.itemBytes = stats.entries * (sizeof(GeohashIndex::value_type) - sizeof(std::string));
+		stats.overheadBytes += (index.capacity() - index.size()) * sizeof(GeohashIndex::value_type);
+
+		// 5 bits per character
+		stats.note = std::to_string(precision) + " character keys need " + std::to_string(5 * precision)
+			+ " bits: as integers the entries would take " + std::to_string(sizeof(std::uint64_t) + sizeof(std::size_t)) + " bytes instead of "
+			+ std::to_string(sizeof(GeohashIndex::value_type));
+		return stats;
+	}
+
+	IndexStats aggregateTreeStats(const AggregateRTree& tree){
+
+		IndexStats stats;
+		stats.entries = tree.entryIds.size();
+
+		if(!tree.nodes.empty()){
+
+			TreeWalk walk;
+			std::vector<std::pair<std::uint32_t, std::size_t>> stack{{static_cast<std::uint32_t>(tree.nodes.size() - 1), 1}};
+
+			while(!stack.empty()){
+
+				const auto [n, level] = stack.back();
+				stack.pop_back();
+
+				const AggregateRTree::Node& node = tree.nodes[n];
+				walk.depth = std::max(walk.depth, level);
+
+				if(node.leaf){
+					walk.leaves++;
+					walk.entries += node.end - node.begin;
+					continue;
+				}
+
+				std::vector<const geos::geom::Envelope*> children;
+				for(std::uint32_t child = node.begin; child < node.end; child++){
+					children.push_back(&tree.nodes[child].envelope);
+					stack.push_back({child, level + 1});
+				}
+				walk.inner++;
+				walk.innerChildren += children.size();
+				walk.overlap.add(children);
+			}
+
+			walk.finish(stats, AggregateRTree::NODE_CAPACITY);
+		}
+
+		stats.nodeBytes = tree.nodes.size() * sizeof(AggregateRTree::Node) + tree.counts.size() * sizeof(std::size_t) + tree.sums.size() * sizeof(double);
+		stats.itemBytes = tree.entryEnvelopes.size() * sizeof(geos::geom::Envelope) + tree.entryIds.size() * sizeof(std::size_t) + tree.entryValues.size() * sizeof(double);
+		stats.overheadBytes = (tree.nodes.capacity() - tree.nodes.size()) * sizeof(AggregateRTree::Node)
+			+ (tree.entryEnvelopes.capacity() - tree.entryEnvelopes.size()) * sizeof(geos::geom::Envelope);
+		return stats;
+	}
+
+	IndexStats envelopeTableStats(const EnvelopeTable& table){
+
+		IndexStats stats;
+		stats.entries = table.size();
+		// four coordinate columns
+		stats.itemBytes = table.size() * 4 * sizeof(double);
+		return stats;
+	}
+}
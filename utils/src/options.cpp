@@ -0,0 +1,31 @@
+#include "../headers/options.h"
+
+namespace spatial {
+
+	Options::Options(const std::vector<std::string>& args, const std::set<std::string>& valueNames, const std::set<std::string>& flagNames){
+
+		for(std::size_t i = 0; i < args.size(); i++){
+
+			if(!args[i].starts_with("--")){
+				positionalArgs.push_back(args[i]);
+				continue;
+			}
+
+			std::string name = args[i].substr(2);
+			const std::size_t equals = name.find('=');
+
+			if(equals != std::string::npos && valueNames.contains(name.substr(0, equals))){
+				values[name.substr(0, equals)] = name.substr(equals + 1);
+			}else if(valueNames.contains(name)){
+				if(i + 1 >= args.size()){
+					throw std::invalid_argument("missing value for --" + name);
+				}
+				values[name] = args[++i];
+			}else if(flagNames.contains(name)){
+				flags.insert(name);
+			}else{
+				throw std::invalid_argument("unknown option --" + name);
+			}
+		}
+	}
+}
@@ -0,0 +1,146 @@
+#include "../headers/perfcounters.h"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+namespace spatial {
+
+	namespace {
+
+		struct EventConfig{
+			std::uint32_t type;
+			std::uint64_t config;
+		};
+
+		constexpr std::uint64_t cacheMiss(const std::uint64_t cache){
+			return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		}
+
+		// same order as Counter
+		constexpr std::array<EventConfig, COUNTERS> EVENTS{{
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+			{PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_L1D)},
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+			{PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_DTLB)},
+		}};
+
+		int openEvent(const EventConfig& event){
+
+			perf_event_attr attr{};
+			attr.size = sizeof(attr);
+			attr.type = event.type;
+			attr.config = event.config;
+			attr.disabled = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+			return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+		}
+
+		std::string describeError(const int error){
+
+			if(error == EACCES || error == EPERM){
+				std::string paranoid = "unknown";
+				std::ifstream file("/proc/sys/kernel/perf_event_paranoid");
+				file>>paranoid;
+				return "perf events are not permitted (kernel.perf_event_paranoid is " + paranoid + ")";
+			}
+			if(error == ENOSYS){
+				return "perf_event_open is not available";
+			}
+			if(error == ENOENT || error == EOPNOTSUPP){
+				return "the CPU exposes no hardware counters";
+			}
+			return std::string("perf_event_open: ") + std::strerror(error);
+		}
+	}
+
+	const char* counterName(Counter counter){
+
+		switch(counter){
+		case Counter::cycles:
+			return "cycles";
+		case Counter::instructions:
+			return "instructions";
+		case Counter::l1dMisses:
+			return "L1d misses";
+		case Counter::llcMisses:
+			return "LLC misses";
+		case Counter::branchMisses:
+			return "branch misses";
+		case Counter::dtlbMisses:
+			return "dTLB misses";
+		}
+		return "";
+	}
+
+	PerfCounters::PerfCounters(){
+
+		int lastError = 0;
+
+		for(std::size_t c = 0; c < COUNTERS; c++){
+			fds[c] = openEvent(EVENTS[c]);
+			if(fds[c] < 0){
+				lastError = errno;
+			}else{
+				opened++;
+			}
+		}
+
+		if(opened == 0){
+			failure = describeError(lastError);
+		}
+	}
+
+	PerfCounters::~PerfCounters(){
+
+		for(const int fd : fds){
+			if(fd >= 0){
+				::close(fd);
+			}
+		}
+	}
+
+	void PerfCounters::start(){
+
+		for(const int fd : fds){
+			if(fd >= 0){
+				ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+				ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+		}
+	}
+
+	CounterValues PerfCounters::stop(){
+
+		for(const int fd : fds){
+			if(fd >= 0){
+				ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+			}
+		}
+
+		CounterValues result;
+
+		for(std::size_t c = 0; c < COUNTERS; c++){
+
+			// value, time enabled, time running
+			std::uint64_t data[3];
+			if(fds[c] < 0 || ::read(fds[c], data, sizeof(data)) != sizeof(data) || data[2] == 0){
+				continue;
+			}
+
+			result.values[c] = static_cast<double>(data[0]) * data[1] / data[2];
+			result.available[c] = true;
+		}
+
+		return result;
+	}
+}
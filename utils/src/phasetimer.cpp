@@ -0,0 +1,43 @@
+#include "../headers/phasetimer.h"
+
+#include <chrono>
+#include <thread>
+
+namespace spatial {
+
+	const char* phaseName(Phase phase){
+
+		switch(phase){
+		case Phase::traversal:
+			return "traversal";
+		case Phase::envelopeRefine:
+			return "envelope refine";
+		case Phase::exactRefine:
+			return "exact refine";
+		case Phase::partition:
+			return "partition";
+		case Phase::insert:
+			return "insert";
+		case Phase::sort:
+			return "sort";
+		}
+		return "";
+	}
+
+	double ticksPerNanosecond(){
+
+#ifdef SPATIAL_PROFILE_PHASES
+		static const double ratio = [](){
+			const auto start = std::chrono::steady_clock::now();
+			const std::uint64_t startTicks = readTicks();
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			const std::uint64_t ticks = readTicks() - startTicks;
+			const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+			return static_cast<double>(ticks) / nanoseconds;
+		}();
+		return ratio;
+#else
+		return 1.0;
+#endif
+	}
+}
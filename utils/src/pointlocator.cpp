@@ -0,0 +1,46 @@
+#include "../headers/pointlocator.h"
+
+#include <geos/algorithm/locate/SimplePointInAreaLocator.h>
+#include <geos/geom/Location.h>
+
+namespace spatial {
+
+	PolygonLayerLocator::PolygonLayerLocator(const std::vector<std::shared_ptr<geos::geom::Geometry>>& polygons) :
+		polygons(polygons),
+		indexOnce(new std::once_flag[polygons.size()]),
+		indexes(polygons.size()) {}
+
+	bool PolygonLayerLocator::covers(std::size_t id, const geos::geom::CoordinateXY& point){
+
+		const geos::geom::Geometry& polygon = *polygons[id];
+
+		if(polygon.getGeometryTypeId() != geos::geom::GEOS_POLYGON && polygon.getGeometryTypeId() != geos::geom::GEOS_MULTIPOLYGON){
+			return false;
+		}
+		if(!polygon.getEnvelopeInternal()->covers(point.x, point.y)){
+			return false;
+		}
+
+		if(polygon.getNumPoints() < INDEX_MIN_POINTS){
+			return geos::algorithm::locate::SimplePointInAreaLocator::locate(point, &polygon) != geos::geom::Location::EXTERIOR;
+		}
+
+		std::call_once(indexOnce[id], [this, id, &polygon, &point]{
+			auto index = std::make_unique<geos::algorithm::locate::IndexedPointInAreaLocator>(polygon);
+			// GEOS builds the edge index on the first locate()
+			index->locate(&point);
+			indexes[id] = std::move(index);
+		});
+
+		return indexes[id]->locate(&point) != geos::geom::Location::EXTERIOR;
+	}
+
+	std::size_t PolygonLayerLocator::indexedPolygons() const{
+
+		std::size_t count = 0;
+		for(const auto& index : indexes){
+			count += index != nullptr;
+		}
+		return count;
+	}
+}
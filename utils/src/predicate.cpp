@@ -0,0 +1,133 @@
+#include "../headers/predicate.h"
+#include "../headers/preparedcache.h"
+
+#include <geos/geom/GeometryFactory.h>
+#include <geos/geom/prep/PreparedGeometryFactory.h>
+
+namespace spatial {
+
+	bool parsePredicate(const std::string& name, Predicate& predicate){
+
+		if(name == "bbox"){
+			predicate = Predicate::bbox;
+		}else if(name == "intersects"){
+			predicate = Predicate::intersects;
+		}else if(name == "contains"){
+			predicate = Predicate::contains;
+		}else if(name == "within"){
+			predicate = Predicate::within;
+		}else{
+			return false;
+		}
+		return true;
+	}
+
+	const char* predicateName(Predicate predicate){
+
+		switch(predicate){
+		case Predicate::bbox:
+			return "bbox";
+		case Predicate::intersects:
+			return "intersects";
+		case Predicate::contains:
+			return "contains";
+		case Predicate::within:
+			return "within";
+		}
+		return "unknown";
+	}
+
+	QueryRegion::QueryRegion(const geos::geom::Envelope& envelope) :
+		envelope(envelope),
+		geometry(geos::geom::GeometryFactory::getDefaultInstance()->toGeometry(&envelope)) {}
+
+	QueryRegion::QueryRegion(std::unique_ptr<geos::geom::Geometry> shape) :
+		envelope(*shape->getEnvelopeInternal()),
+		geometry(std::move(shape))
+	{
+		if(!geometry->isRectangle()){
+			prepared = geos::geom::prep::PreparedGeometryFactory::prepare(geometry.get());
+		}
+	}
+
+	Coverage QueryRegion::classify(const geos::geom::Envelope& nodeEnvelope) const{
+
+		if(!envelope.intersects(nodeEnvelope)){
+			return Coverage::outside;
+		}
+
+		if(!prepared){
+			return envelope.contains(nodeEnvelope) ? Coverage::inside : Coverage::boundary;
+		}
+
+		const std::unique_ptr<geos::geom::Geometry> nodeGeometry = geometry->getFactory()->toGeometry(&nodeEnvelope);
+
+		if(prepared->containsProperly(nodeGeometry.get())){
+			return Coverage::inside;
+		}
+		return prepared->intersects(nodeGeometry.get()) ? Coverage::boundary : Coverage::outside;
+	}
+
+	bool evaluate(Predicate predicate, const QueryRegion& region, std::size_t id, const geos::geom::Geometry& feature, PreparedGeometryCache* cache){
+
+		const geos::geom::Geometry& query = region.getGeometry();
+		const geos::geom::prep::PreparedGeometry* preparedQuery = region.getPrepared();
+
+		switch(predicate){
+
+		case Predicate::bbox:
+			return region.getEnvelope().contains(feature.getEnvelopeInternal());
+
+		case Predicate::intersects:
+			if(preparedQuery){
+				return preparedQuery->intersects(&feature);
+			}
+			if(cache){
+				PreparedGeometryCache::Lease preparedFeature = cache->lease(id, feature);
+				if(preparedFeature.get()){
+					return preparedFeature.get()->intersects(&query);
+				}
+			}
+			return query.intersects(&feature);
+
+		case Predicate::contains:
+			if(cache){
+				PreparedGeometryCache::Lease preparedFeature = cache->lease(id, feature);
+				if(preparedFeature.get()){
+					return preparedFeature.get()->contains(&query);
+				}
+			}
+			return feature.contains(&query);
+
+		case Predicate::within:
+			// a rectangle query takes the GEOS rectangle fast path in contains()
+			return preparedQuery ? preparedQuery->contains(&feature) : query.contains(&feature);
+		}
+
+		return false;
+	}
+
+	bool evaluatePair(Predicate predicate, std::size_t id, const geos::geom::Geometry& feature, const geos::geom::Geometry& other, PreparedGeometryCache* cache){
+
+		switch(predicate){
+
+		case Predicate::bbox:
+			return other.getEnvelopeInternal()->contains(feature.getEnvelopeInternal());
+
+		case Predicate::intersects:
+		case Predicate::contains:
+			if(cache){
+				PreparedGeometryCache::Lease preparedFeature = cache->lease(id, feature);
+				if(preparedFeature.get()){
+					return predicate == Predicate::intersects ? preparedFeature.get()->intersects(&other) : preparedFeature.get()->contains(&other);
+				}
+			}
+			return predicate == Predicate::intersects ? feature.intersects(&other) : feature.contains(&other);
+
+		case Predicate::within:
+			return other.contains(&feature);
+		}
+
+		return false;
+	}
+}
@@ -0,0 +1,79 @@
+#include "../headers/preparedcache.h"
+
+#include <geos/geom/prep/PreparedGeometryFactory.h>
+
+namespace spatial {
+
+	PreparedGeometryCache::PreparedGeometryCache(std::size_t geometryCount, std::size_t capacity) :
+		hitCounts(new std::atomic<std::uint32_t>[geometryCount]()),
+		shardCapacity(std::max<std::size_t>(1, capacity / SHARDS)) {}
+
+	PreparedGeometryCache::Lease PreparedGeometryCache::lease(std::size_t id, const geos::geom::Geometry& geometry){
+
+		// points and short lines gain nothing from being prepared
+		if(geometry.getNumPoints() < PREPARE_MIN_POINTS){
+			return {};
+		}
+
+		lookups++;
+
+		if(hitCounts[id].fetch_add(1, std::memory_order_relaxed) + 1 < PREPARE_AFTER_HITS){
+			return {};
+		}
+
+		Shard& shard = shards[id % SHARDS];
+		std::shared_ptr<Entry> entry;
+		{
+			std::lock_guard lock(shard.mutex);
+
+			auto it = shard.entries.find(id);
+			if(it != shard.entries.end()){
+				hits++;
+				shard.recent.splice(shard.recent.begin(), shard.recent, it->second.second);
+				entry = it->second.first;
+			}else{
+				if(shard.entries.size() >= shardCapacity){
+					shard.entries.erase(shard.recent.back());
+					shard.recent.pop_back();
+					evicted++;
+				}
+				entry = std::make_shared<Entry>();
+				shard.recent.push_front(id);
+				shard.entries.emplace(id, std::make_pair(entry, shard.recent.begin()));
+			}
+		}
+
+		std::unique_ptr<geos::geom::prep::PreparedGeometry> copy;
+		{
+			std::lock_guard lock(entry->mutex);
+			if(!entry->idle.empty()){
+				copy = std::move(entry->idle.back());
+				entry->idle.pop_back();
+			}
+		}
+
+		// prepared outside both locks, when every copy is in use
+		if(!copy){
+			copy = geos::geom::prep::PreparedGeometryFactory::prepare(&geometry);
+			prepared++;
+		}
+
+		return Lease(std::move(entry), std::move(copy));
+	}
+
+	PreparedGeometryCache::Statistics PreparedGeometryCache::statistics() const{
+
+		Statistics stats;
+		stats.lookups = lookups;
+		stats.hits = hits;
+		stats.prepared = prepared;
+		stats.evicted = evicted;
+
+		for(const Shard& shard : shards){
+			std::lock_guard lock(shard.mutex);
+			stats.entries += shard.entries.size();
+		}
+
+		return stats;
+	}
+}
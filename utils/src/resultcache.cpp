@@ -0,0 +1,141 @@
+#include "../headers/resultcache.h"
+
+#include <cmath>
+#include <functional>
+
+namespace spatial {
+
+	std::size_t ResultCache::KeyHash::operator()(const Key& key) const{
+
+		std::size_t hash = std::hash<std::string>()(key.index);
+		for(const std::int64_t cell : {key.minX, key.minY, key.maxX, key.maxY}){
+			hash = (hash ^ static_cast<std::size_t>(cell)) * 0x100000001B3ull;
+		}
+		return hash;
+	}
+
+	void ResultCache::configure(const std::size_t budget, const double resolution){
+
+		std::lock_guard lock(mutex);
+
+		if(resolution != this->resolution){
+			recent.clear();
+			entries.clear();
+			bytes = 0;
+			this->resolution = resolution;
+		}
+		this->budget = budget;
+		evict();
+	}
+
+	bool ResultCache::enabled() const{
+
+		std::lock_guard lock(mutex);
+		return budget > 0;
+	}
+
+	ResultCache::Key ResultCache::key(const std::string& index, const geos::geom::Envelope& envelope) const{
+
+		double cellSize;
+		{
+			std::lock_guard lock(mutex);
+			cellSize = resolution;
+		}
+
+		// rounded outwards, so the cells cover the envelope
+		return {static_cast<std::int64_t>(std::floor(envelope.getMinX() / cellSize)), static_cast<std::int64_t>(std::floor(envelope.getMinY() / cellSize)),
+			static_cast<std::int64_t>(std::ceil(envelope.getMaxX() / cellSize)), static_cast<std::int64_t>(std::ceil(envelope.getMaxY() / cellSize)), index};
+	}
+
+	geos::geom::Envelope ResultCache::cellEnvelope(const Key& key) const{
+
+		std::lock_guard lock(mutex);
+		return geos::geom::Envelope(key.minX * resolution, key.maxX * resolution, key.minY * resolution, key.maxY * resolution);
+	}
+
+	bool ResultCache::lookup(const Key& key, std::vector<std::size_t>& ids){
+
+		std::lock_guard lock(mutex);
+		lookups++;
+
+		const auto it = entries.find(key);
+		if(it == entries.end()){
+			return false;
+		}
+
+		hits++;
+		recent.splice(recent.begin(), recent, it->second);
+		ids.assign(it->second->ids.begin(), it->second->ids.end());
+		return true;
+	}
+
+	void ResultCache::insert(const Key& key, const std::vector<std::size_t>& ids){
+
+		// the entry, its list and map nodes and the results
+		const std::size_t entryBytes = sizeof(Entry) + sizeof(Key) + 6 * sizeof(void*) + ids.size() * sizeof(std::size_t);
+
+		std::lock_guard lock(mutex);
+
+		if(entryBytes > budget || entries.count(key) > 0){
+			return;
+		}
+
+		recent.push_front({key, ids, entryBytes});
+		entries.emplace(key, recent.begin());
+		bytes += entryBytes;
+		evict();
+	}
+
+	void ResultCache::invalidate(const std::string& index){
+
+		std::lock_guard lock(mutex);
+
+		for(auto it = recent.begin(); it != recent.end(); ){
+			const auto next = std::next(it);
+			if(it->key.index == index){
+				erase(it);
+				invalidated++;
+			}
+			it = next;
+		}
+	}
+
+	void ResultCache::clear(){
+
+		std::lock_guard lock(mutex);
+		recent.clear();
+		entries.clear();
+		bytes = 0;
+	}
+
+	ResultCache::Statistics ResultCache::statistics() const{
+
+		std::lock_guard lock(mutex);
+
+		Statistics stats;
+		stats.lookups = lookups;
+		stats.hits = hits;
+		stats.evicted = evicted;
+		stats.invalidated = invalidated;
+		stats.entries = entries.size();
+		stats.bytes = bytes;
+		stats.budget = budget;
+		stats.resolution = resolution;
+		return stats;
+	}
+
+	void ResultCache::erase(const EntryList::iterator entry){
+
+		bytes -= entry->bytes;
+		entries.erase(entry->key);
+		recent.erase(entry);
+	}
+
+	void ResultCache::evict(){
+
+		while(bytes > budget){
+			erase(std::prev(recent.end()));
+			evicted++;
+		}
+	}
+}
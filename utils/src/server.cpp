@@ -0,0 +1,398 @@
+#include "../headers/server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <system_error>
+
+namespace spatial {
+
+	namespace {
+
+		constexpr std::uint64_t LISTEN_KEY = 0;
+		constexpr std::uint64_t WAKE_KEY = 1;
+		constexpr std::size_t READ_SIZE = 64 * 1024;
+		constexpr std::size_t MAX_ERROR_SIZE = 1024;
+
+		[[noreturn]] void throwErrno(const std::string& what){
+			throw std::system_error(errno, std::generic_category(), what);
+		}
+
+		void control(int epollFd, int operation, int fd, std::uint32_t events, std::uint64_t key){
+			epoll_event event{};
+			event.events = events;
+			event.data.u64 = key;
+			if(epoll_ctl(epollFd, operation, fd, &event) < 0){
+				throwErrno("epoll_ctl");
+			}
+		}
+	}
+
+	QueryServer::QueryServer(Handler handler, std::size_t threads) :
+		handler(std::move(handler))
+	{
+		epollFd = epoll_create1(EPOLL_CLOEXEC);
+		if(epollFd < 0){
+			throwErrno("epoll_create1");
+		}
+
+		wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if(wakeFd < 0){
+			::close(epollFd);
+			throwErrno("eventfd");
+		}
+		control(epollFd, EPOLL_CTL_ADD, wakeFd, EPOLLIN, WAKE_KEY);
+
+		workers.resize(std::max<std::size_t>(threads, 1));
+	}
+
+	QueryServer::~QueryServer(){
+
+		for(auto& [key, connection] : connections){
+			::close(connection.fd);
+		}
+		if(listenFd >= 0){
+			::close(listenFd);
+		}
+		if(!unixPath.empty()){
+			unlink(unixPath.c_str());
+		}
+		::close(wakeFd);
+		::close(epollFd);
+	}
+
+	void QueryServer::listenUnix(const std::string& path){
+
+		sockaddr_un address{};
+		if(path.size() >= sizeof(address.sun_path)){
+			throw std::system_error(ENAMETOOLONG, std::generic_category(), path);
+		}
+		address.sun_family = AF_UNIX;
+		path.copy(address.sun_path, path.size());
+
+		listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if(listenFd < 0){
+			throwErrno("socket");
+		}
+
+		// a socket file left behind by a previous server
+		unlink(path.c_str());
+
+		if(bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0){
+			throwErrno("bind " + path);
+		}
+		unixPath = path;
+
+		if(listen(listenFd, SOMAXCONN) < 0){
+			throwErrno("listen");
+		}
+		control(epollFd, EPOLL_CTL_ADD, listenFd, EPOLLIN, LISTEN_KEY);
+	}
+
+	void QueryServer::listenTcp(std::uint16_t port){
+
+		listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if(listenFd < 0){
+			throwErrno("socket");
+		}
+
+		const int enable = 1;
+		setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(port);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		if(bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0){
+			throwErrno("bind 127.0.0.1:" + std::to_string(port));
+		}
+		if(listen(listenFd, SOMAXCONN) < 0){
+			throwErrno("listen");
+		}
+		control(epollFd, EPOLL_CTL_ADD, listenFd, EPOLLIN, LISTEN_KEY);
+	}
+
+	void QueryServer::run(){
+
+		stopRequested = false;
+		stopping = false;
+
+		// the workers are joined however the loop ends: a joinable thread
+		// left behind by an exception would terminate the process
+		struct WorkersGuard{
+			QueryServer& server;
+			~WorkersGuard(){
+				server.stopWorkers();
+			}
+		} workersGuard{*this};
+
+		for(std::thread& worker : workers){
+			worker = std::thread(&QueryServer::work, this);
+		}
+
+		std::vector<epoll_event> events(64);
+
+		while(!stopRequested){
+
+			const int count = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), -1);
+			if(count < 0){
+				if(errno == EINTR){
+					continue;
+				}
+				throwErrno("epoll_wait");
+			}
+
+			for(int e = 0; e < count; e++){
+
+				const std::uint64_t key = events[e].data.u64;
+
+				if(key == LISTEN_KEY){
+					accept();
+				}else if(key == WAKE_KEY){
+					std::uint64_t value;
+					while(::read(wakeFd, &value, sizeof(value)) > 0){}
+					deliver();
+				}else{
+					// an earlier event of the batch may have closed it
+					if((events[e].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) && connections.contains(key)){
+						read(key);
+					}
+					if((events[e].events & EPOLLOUT) && connections.contains(key)){
+						write(key);
+					}
+				}
+			}
+		}
+	}
+
+	void QueryServer::stopWorkers(){
+
+		{
+			std::lock_guard<std::mutex> lock(tasksMutex);
+			stopping = true;
+			tasks.clear();
+		}
+		tasksReady.notify_all();
+
+		for(std::thread& worker : workers){
+			if(worker.joinable()){
+				worker.join();
+			}
+		}
+	}
+
+	void QueryServer::stop(){
+
+		stopRequested = true;
+		const std::uint64_t one = 1;
+		[[maybe_unused]] const ssize_t written = ::write(wakeFd, &one, sizeof(one));
+	}
+
+	QueryServer::Statistics QueryServer::statistics() const{
+
+		std::lock_guard<std::mutex> lock(statsMutex);
+		return stats;
+	}
+
+	void QueryServer::accept(){
+
+		while(true){
+
+			const int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if(fd < 0){
+				// EAGAIN once the backlog is empty; other errors only lose that client
+				return;
+			}
+
+			// fails harmlessly on Unix sockets
+			const int enable = 1;
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+			const std::uint64_t key = nextKey++;
+			connections.emplace(key, Connection(fd));
+			control(epollFd, EPOLL_CTL_ADD, fd, EPOLLIN, key);
+
+			std::lock_guard<std::mutex> lock(statsMutex);
+			stats.connections++;
+		}
+	}
+
+	void QueryServer::read(std::uint64_t key){
+
+		Connection& connection = connections.at(key);
+
+		while(true){
+
+			const std::size_t size = connection.input.size();
+			connection.input.resize(size + READ_SIZE);
+
+			const ssize_t received = recv(connection.fd, connection.input.data() + size, READ_SIZE, 0);
+			connection.input.resize(size + std::max<ssize_t>(received, 0));
+
+			if(received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)){
+				close(key);
+				return;
+			}
+			if(received < 0){
+				break;
+			}
+		}
+
+		// hand every complete frame to the query threads
+		std::size_t offset = 0;
+		std::size_t queued = 0;
+
+		while(connection.input.size() - offset >= 4){
+
+			protocol::Reader header(connection.input.data() + offset, connection.input.size() - offset);
+			const std::uint32_t size = header.get<std::uint32_t>();
+
+			if(size < protocol::REQUEST_HEADER_SIZE - 4 || size > protocol::MAX_FRAME_SIZE){
+				close(key);
+				return;
+			}
+			if(header.remaining() < size){
+				break;
+			}
+
+			const protocol::Opcode opcode = header.get<protocol::Opcode>();
+			const std::uint32_t id = header.get<std::uint32_t>();
+			const char* payload = connection.input.data() + offset + protocol::REQUEST_HEADER_SIZE;
+
+			{
+				std::lock_guard<std::mutex> lock(tasksMutex);
+				tasks.push_back(Task{key, id, opcode, std::string(payload, size - (protocol::REQUEST_HEADER_SIZE - 4))});
+			}
+			tasksReady.notify_one();
+
+			offset += 4 + size;
+			queued++;
+		}
+
+		connection.input.erase(0, offset);
+
+		std::lock_guard<std::mutex> lock(statsMutex);
+		stats.requests += queued;
+	}
+
+	void QueryServer::write(std::uint64_t key){
+
+		Connection& connection = connections.at(key);
+
+		while(connection.written < connection.output.size()){
+
+			const ssize_t sent = send(connection.fd, connection.output.data() + connection.written, connection.output.size() - connection.written, MSG_NOSIGNAL);
+
+			if(sent < 0){
+				if(errno == EAGAIN || errno == EWOULDBLOCK){
+					break;
+				}
+				if(errno == EINTR){
+					continue;
+				}
+				close(key);
+				return;
+			}
+			connection.written += sent;
+		}
+
+		const bool pending = connection.written < connection.output.size();
+
+		if(!pending){
+			connection.output.clear();
+			connection.written = 0;
+		}
+
+		// wait for EPOLLOUT only while the kernel buffer is full
+		if(pending != connection.writing){
+			connection.writing = pending;
+			control(epollFd, EPOLL_CTL_MOD, connection.fd, pending ? (EPOLLIN | EPOLLOUT) : EPOLLIN, key);
+		}
+	}
+
+	void QueryServer::close(std::uint64_t key){
+
+		auto it = connections.find(key);
+		if(it == connections.end()){
+			return;
+		}
+
+		epoll_ctl(epollFd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+		::close(it->second.fd);
+		connections.erase(it);
+	}
+
+	void QueryServer::deliver(){
+
+		std::vector<Completion> ready;
+		{
+			std::lock_guard<std::mutex> lock(completionsMutex);
+			ready.swap(completions);
+		}
+
+		std::vector<std::uint64_t> touched;
+
+		for(Completion& completion : ready){
+			// the client may have gone away while its request was running
+			auto it = connections.find(completion.connection);
+			if(it != connections.end()){
+				if(it->second.output.empty()){
+					touched.push_back(completion.connection);
+				}
+				it->second.output += completion.frame;
+			}
+		}
+
+		for(const std::uint64_t key : touched){
+			if(connections.contains(key)){
+				write(key);
+			}
+		}
+	}
+
+	void QueryServer::work(){
+
+		while(true){
+
+			Task task;
+			{
+				std::unique_lock<std::mutex> lock(tasksMutex);
+				tasksReady.wait(lock, [this]{ return stopping || !tasks.empty(); });
+				if(stopping){
+					return;
+				}
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+
+			std::string frame;
+
+			try{
+				protocol::Reader payload(task.payload);
+				frame = protocol::responseFrame(task.id, protocol::Status::ok, handler(task.opcode, payload));
+			}catch(const std::exception& e){
+				const std::string message = std::string(e.what()).substr(0, MAX_ERROR_SIZE);
+				frame = protocol::responseFrame(task.id, protocol::Status::error, protocol::Writer().putString(message).take());
+
+				std::lock_guard<std::mutex> lock(statsMutex);
+				stats.errors++;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(completionsMutex);
+				completions.push_back(Completion{task.connection, std::move(frame)});
+			}
+
+			const std::uint64_t one = 1;
+			[[maybe_unused]] const ssize_t written = ::write(wakeFd, &one, sizeof(one));
+		}
+	}
+}
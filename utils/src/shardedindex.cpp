@@ -0,0 +1,51 @@
+#include "../headers/shardedindex.h"
+
+#include <cmath>
+#include <numeric>
+
+namespace spatial {
+
+	std::vector<std::vector<std::size_t>> partitionSTR(const std::vector<const geos::geom::Envelope*>& envelopes, std::size_t parts, ThreadPool& pool){
+
+		const std::size_t count = envelopes.size();
+		parts = std::max<std::size_t>(1, std::min(parts, count));
+
+		std::vector<double> centerX(count);
+		std::vector<double> centerY(count);
+		pool.parallelFor(count, 4096, [&](std::size_t, const std::size_t i){
+			centerX[i] = (envelopes[i]->getMinX() + envelopes[i]->getMaxX()) / 2;
+			centerY[i] = (envelopes[i]->getMinY() + envelopes[i]->getMaxY()) / 2;
+		});
+
+		std::vector<std::size_t> order(count);
+		std::iota(order.begin(), order.end(), 0);
+
+		parallelSort(pool, order.begin(), order.end(), [&centerX](const std::size_t a, const std::size_t b){
+			return centerX[a] < centerX[b];
+		});
+
+		// slab s holds the tiles [parts*s/slabs, parts*(s+1)/slabs), so every
+		// tile ends up with count/parts items whatever the slab layout
+		const std::size_t slabs = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(parts))));
+		auto tileBegin = [parts, slabs](const std::size_t slab){
+			return parts * slab / slabs;
+		};
+		auto itemBegin = [count, parts](const std::size_t tile){
+			return count * tile / parts;
+		};
+
+		pool.parallelFor(slabs, 1, [&](std::size_t, const std::size_t slab){
+			std::sort(order.begin() + itemBegin(tileBegin(slab)), order.begin() + itemBegin(tileBegin(slab + 1)),
+				[&centerY](const std::size_t a, const std::size_t b){
+					return centerY[a] < centerY[b];
+				});
+		});
+
+		std::vector<std::vector<std::size_t>> partitions(parts);
+		for(std::size_t tile = 0; tile < parts; tile++){
+			partitions[tile].assign(order.begin() + itemBegin(tile), order.begin() + itemBegin(tile + 1));
+		}
+
+		return partitions;
+	}
+}
@@ -0,0 +1,211 @@
+#include "../headers/spatialjoin.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace spatial {
+
+	namespace {
+
+		struct Grid{
+			double minX;
+			double minY;
+			double cellWidth;
+			double cellHeight;
+			std::size_t size;
+
+			std::size_t cellX(const double x) const{
+				return toCell((x - minX) / cellWidth);
+			}
+
+			std::size_t cellY(const double y) const{
+				return toCell((y - minY) / cellHeight);
+			}
+
+			std::size_t toCell(const double position) const{
+				if(!(position > 0)){
+					return 0;
+				}
+				return std::min(static_cast<std::size_t>(position), size - 1);
+			}
+		};
+
+		// Features of one layer bucketed by cell: the features of cell c are
+		// items[offsets[c]] .. items[offsets[c+1] - 1].
+		struct Buckets{
+			std::vector<std::size_t> offsets;
+			std::vector<std::size_t> items;
+		};
+
+		// Two passes over the same fixed feature ranges, one per worker: count
+		// the entries of every (range, cell), then write them at their offsets.
+		Buckets bucketize(const std::vector<const geos::geom::Envelope*>& envelopes, const Grid& grid, ThreadPool& pool){
+
+			const std::size_t cells = grid.size * grid.size;
+			const std::size_t ranges = pool.size();
+			auto rangeBegin = [&envelopes, ranges](const std::size_t range){
+				return envelopes.size() * range / ranges;
+			};
+
+			auto forEachCell = [&grid](const geos::geom::Envelope* envelope, auto&& f){
+				if(envelope->isNull()){
+					return;
+				}
+				const std::size_t x1 = grid.cellX(envelope->getMaxX());
+				const std::size_t y1 = grid.cellY(envelope->getMaxY());
+				for(std::size_t y = grid.cellY(envelope->getMinY()); y <= y1; y++){
+					for(std::size_t x = grid.cellX(envelope->getMinX()); x <= x1; x++){
+						f(y * grid.size + x);
+					}
+				}
+			};
+
+			std::vector<std::vector<std::size_t>> counts(ranges, std::vector<std::size_t>(cells + 1));
+
+			pool.parallelFor(ranges, 1, [&](std::size_t, const std::size_t range){
+				std::vector<std::size_t>& rangeCounts = counts[range];
+				for(std::size_t i = rangeBegin(range); i < rangeBegin(range + 1); i++){
+					forEachCell(envelopes[i], [&rangeCounts](const std::size_t cell){
+						rangeCounts[cell]++;
+					});
+				}
+			});
+
+			// counts[range][cell] becomes the write position of that range in the cell
+			Buckets buckets;
+			buckets.offsets.resize(cells + 1);
+			std::size_t position = 0;
+			for(std::size_t cell = 0; cell < cells; cell++){
+				buckets.offsets[cell] = position;
+				for(std::size_t range = 0; range < ranges; range++){
+					const std::size_t count = counts[range][cell];
+					counts[range][cell] = position;
+					position += count;
+				}
+			}
+			buckets.offsets[cells] = position;
+			buckets.items.resize(position);
+
+			pool.parallelFor(ranges, 1, [&](std::size_t, const std::size_t range){
+				std::vector<std::size_t>& next = counts[range];
+				for(std::size_t i = rangeBegin(range); i < rangeBegin(range + 1); i++){
+					forEachCell(envelopes[i], [&buckets, &next, i](const std::size_t cell){
+						buckets.items[next[cell]++] = i;
+					});
+				}
+			});
+
+			return buckets;
+		}
+	}
+
+	std::size_t defaultJoinGridSize(std::size_t features, std::size_t workers){
+
+		const std::size_t bySize = static_cast<std::size_t>(std::sqrt(features / 1024.0));
+		const std::size_t byWorkers = static_cast<std::size_t>(std::ceil(std::sqrt(4.0 * workers)));
+
+		return std::clamp<std::size_t>(std::max(bySize, byWorkers), 1, 1024);
+	}
+
+	JoinStats gridJoin(const std::vector<const geos::geom::Envelope*>& left, const std::vector<const geos::geom::Envelope*>& right,
+					   std::size_t gridSize, ThreadPool& pool, const std::function<bool(std::size_t, std::size_t)>& refine){
+
+		JoinStats stats;
+		stats.gridSize = gridSize = std::max<std::size_t>(gridSize, 1);
+
+		const auto start = std::chrono::steady_clock::now();
+
+		geos::geom::Envelope extent;
+		for(const auto* layer : {&left, &right}){
+			for(const geos::geom::Envelope* envelope : *layer){
+				extent.expandToInclude(envelope);
+			}
+		}
+
+		if(extent.isNull()){
+			return stats;
+		}
+
+		const Grid grid{extent.getMinX(), extent.getMinY(),
+						std::max(extent.getWidth() / gridSize, std::numeric_limits<double>::min()),
+						std::max(extent.getHeight() / gridSize, std::numeric_limits<double>::min()),
+						gridSize};
+
+		const Buckets leftBuckets = bucketize(left, grid, pool);
+		const Buckets rightBuckets = bucketize(right, grid, pool);
+		stats.leftEntries = leftBuckets.items.size();
+		stats.rightEntries = rightBuckets.items.size();
+
+		const auto partitioned = std::chrono::steady_clock::now();
+		stats.partitionTime = std::chrono::duration<double, std::milli>(partitioned - start).count();
+
+		std::vector<std::vector<std::pair<std::size_t, std::size_t>>> workerCandidates(pool.size());
+
+		pool.parallelFor(gridSize * gridSize, 1, [&](const std::size_t worker, const std::size_t cell){
+
+			std::vector<std::size_t> l(leftBuckets.items.begin() + leftBuckets.offsets[cell], leftBuckets.items.begin() + leftBuckets.offsets[cell + 1]);
+			std::vector<std::size_t> r(rightBuckets.items.begin() + rightBuckets.offsets[cell], rightBuckets.items.begin() + rightBuckets.offsets[cell + 1]);
+
+			if(l.empty() || r.empty()){
+				return;
+			}
+
+			std::sort(l.begin(), l.end(), [&left](const std::size_t a, const std::size_t b){ return left[a]->getMinX() < left[b]->getMinX(); });
+			std::sort(r.begin(), r.end(), [&right](const std::size_t a, const std::size_t b){ return right[a]->getMinX() < right[b]->getMinX(); });
+
+			std::vector<std::pair<std::size_t, std::size_t>>& candidates = workerCandidates[worker];
+
+			auto report = [&](const std::size_t li, const std::size_t ri){
+				const geos::geom::Envelope* a = left[li];
+				const geos::geom::Envelope* b = right[ri];
+				if(a->getMinY() > b->getMaxY() || b->getMinY() > a->getMaxY()){
+					return;
+				}
+				const double referenceX = std::max(a->getMinX(), b->getMinX());
+				const double referenceY = std::max(a->getMinY(), b->getMinY());
+				if(grid.cellY(referenceY) * grid.size + grid.cellX(referenceX) == cell){
+					candidates.emplace_back(li, ri);
+				}
+			};
+
+			std::size_t i = 0, j = 0;
+			while(i < l.size() && j < r.size()){
+				if(left[l[i]]->getMinX() <= right[r[j]]->getMinX()){
+					for(std::size_t k = j; k < r.size() && right[r[k]]->getMinX() <= left[l[i]]->getMaxX(); k++){
+						report(l[i], r[k]);
+					}
+					i++;
+				}else{
+					for(std::size_t k = i; k < l.size() && left[l[k]]->getMinX() <= right[r[j]]->getMaxX(); k++){
+						report(l[k], r[j]);
+					}
+					j++;
+				}
+			}
+		});
+
+		std::vector<std::pair<std::size_t, std::size_t>> candidates;
+		for(const auto& worker : workerCandidates){
+			candidates.insert(candidates.end(), worker.begin(), worker.end());
+		}
+		stats.candidates = candidates.size();
+
+		const auto filtered = std::chrono::steady_clock::now();
+		stats.filterTime = std::chrono::duration<double, std::milli>(filtered - partitioned).count();
+
+		std::vector<std::size_t> workerPairs(pool.size());
+		pool.parallelFor(candidates.size(), 256, [&](const std::size_t worker, const std::size_t c){
+			if(refine(candidates[c].first, candidates[c].second)){
+				workerPairs[worker]++;
+			}
+		});
+		stats.pairs = std::accumulate(workerPairs.begin(), workerPairs.end(), std::size_t(0));
+
+		stats.refineTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - filtered).count();
+
+		return stats;
+	}
+}
@@ -0,0 +1,123 @@
+#include "../headers/threadpool.h"
+
+namespace spatial {
+
+	ThreadPool::ThreadPool(std::size_t threadCount) :
+		slices(new Slice[std::max<std::size_t>(threadCount, 1)])
+	{
+		for(std::size_t w = 1; w < threadCount; w++){
+			threads.emplace_back(&ThreadPool::workerLoop, this, w);
+		}
+	}
+
+	ThreadPool::~ThreadPool(){
+		{
+			std::lock_guard lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+
+		for(std::thread& thread : threads){
+			thread.join();
+		}
+	}
+
+	bool ThreadPool::nextChunk(std::size_t worker, std::size_t grain, std::size_t& begin, std::size_t& end){
+
+		Slice& own = slices[worker];
+		{
+			std::lock_guard lock(own.mutex);
+			if(own.begin < own.end){
+				begin = own.begin;
+				end = std::min(own.begin + grain, own.end);
+				own.begin = end;
+				return true;
+			}
+		}
+
+		// steal from the worker with the most work left, retrying if it was
+		// drained between the scan and the lock
+		while(true){
+
+			std::size_t victim = worker;
+			std::size_t largest = 0;
+
+			for(std::size_t w = 0; w < size(); w++){
+				if(w == worker){
+					continue;
+				}
+				std::lock_guard lock(slices[w].mutex);
+				if(slices[w].end - slices[w].begin > largest){
+					largest = slices[w].end - slices[w].begin;
+					victim = w;
+				}
+			}
+
+			if(victim == worker){
+				return false;
+			}
+
+			std::size_t stolenBegin, stolenEnd;
+			{
+				std::lock_guard lock(slices[victim].mutex);
+				Slice& other = slices[victim];
+				if(other.begin >= other.end){
+					continue;
+				}
+				stolenEnd = other.end;
+				stolenBegin = other.begin + (other.end - other.begin) / 2;
+				other.end = stolenBegin;
+			}
+
+			begin = stolenBegin;
+			end = std::min(stolenBegin + grain, stolenEnd);
+
+			std::lock_guard lock(own.mutex);
+			own.begin = end;
+			own.end = stolenEnd;
+			return true;
+		}
+	}
+
+	void ThreadPool::runOnAll(const std::function<void(std::size_t)>& newJob){
+		{
+			std::lock_guard lock(mutex);
+			job = &newJob;
+			running = threads.size();
+			generation++;
+		}
+		wake.notify_all();
+
+		newJob(0);
+
+		std::unique_lock lock(mutex);
+		done.wait(lock, [this]{ return running == 0; });
+		job = nullptr;
+	}
+
+	void ThreadPool::workerLoop(std::size_t worker){
+
+		std::size_t seen = 0;
+
+		while(true){
+
+			const std::function<void(std::size_t)>* current;
+			{
+				std::unique_lock lock(mutex);
+				wake.wait(lock, [this, seen]{ return stopping || generation != seen; });
+				if(stopping){
+					return;
+				}
+				seen = generation;
+				current = job;
+			}
+
+			(*current)(worker);
+
+			std::lock_guard lock(mutex);
+			if(--running == 0){
+				done.notify_one();
+			}
+		}
+	}
+}
@@ -0,0 +1,370 @@
+#include "../headers/workload.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <istream>
+#include <limits>
+#include <numbers>
+#include <ostream>
+#include <sstream>
+#include <tuple>
+
+namespace spatial {
+
+	namespace {
+
+		constexpr std::array<const char*, QUERY_KINDS> kindNames{"point", "box", "radius", "knn"};
+	}
+
+	const char* queryKindName(QueryKind kind){
+		return kindNames[static_cast<std::size_t>(kind)];
+	}
+
+	bool parseDistribution(const std::string& name, QueryDistribution& distribution){
+
+		if(name == "uniform"){
+			distribution = QueryDistribution::uniform;
+		}else if(name == "data"){
+			distribution = QueryDistribution::data;
+		}else if(name == "zipf"){
+			distribution = QueryDistribution::zipf;
+		}else{
+			return false;
+		}
+		return true;
+	}
+
+	const char* distributionName(QueryDistribution distribution){
+
+		switch(distribution){
+		case QueryDistribution::uniform:
+			return "uniform";
+		case QueryDistribution::data:
+			return "data";
+		case QueryDistribution::zipf:
+			return "zipf";
+		}
+		return "";
+	}
+
+	bool parseMix(const std::string& text, std::array<double, QUERY_KINDS>& mix){
+
+		std::array<double, QUERY_KINDS> weights{};
+		std::istringstream items(text);
+
+		for(std::string item; std::getline(items, item, ','); ){
+
+			const std::size_t equals = item.find('=');
+			const std::string name = item.substr(0, equals);
+			const auto kind = std::find(kindNames.begin(), kindNames.end(), name);
+			if(kind == kindNames.end()){
+				return false;
+			}
+
+			double weight = 1;
+			if(equals != std::string::npos){
+				std::istringstream value(item.substr(equals + 1));
+				if(!(value >> weight) || !value.eof() || weight < 0){
+					return false;
+				}
+			}
+			weights[kind - kindNames.begin()] = weight;
+		}
+
+		if(std::all_of(weights.begin(), weights.end(), [](const double w){ return w == 0; })){
+			return false;
+		}
+		mix = weights;
+		return true;
+	}
+
+	std::string describe(const WorkloadSpec& spec){
+
+		std::ostringstream oss;
+		oss<<"seed="<<spec.seed<<" distribution="<<distributionName(spec.distribution);
+		if(spec.selectivity > 0){
+			oss<<" selectivity="<<spec.selectivity;
+		}else{
+			oss<<" sizes=fixed";
+		}
+		if(spec.distribution == QueryDistribution::zipf){
+			oss<<" hotspots="<<spec.hotspots;
+		}
+		oss<<" mix=";
+		bool first = true;
+		for(std::size_t kind = 0; kind < QUERY_KINDS; kind++){
+			if(spec.mix[kind] > 0){
+				oss<<(first ? "" : ",")<<kindNames[kind]<<"="<<spec.mix[kind];
+				first = false;
+			}
+		}
+		if(spec.mix[static_cast<std::size_t>(QueryKind::knn)] > 0){
+			oss<<" k="<<spec.k;
+		}
+		return oss.str();
+	}
+
+	WorkloadGenerator::WorkloadGenerator(const WorkloadSpec& spec, const std::vector<const geos::geom::Envelope*>& features, const geos::geom::Envelope& extent) :
+		spec(spec),
+		extent(extent),
+		engine(spec.seed),
+		kindChoice(spec.mix.begin(), spec.mix.end()),
+		prefix((GRID + 1) * (GRID + 1), 0.0)
+	{
+		for(const geos::geom::Envelope* envelope : features){
+			if(envelope && !envelope->isNull()){
+				featureCenters.emplace_back((envelope->getMinX() + envelope->getMaxX()) / 2, (envelope->getMinY() + envelope->getMaxY()) / 2);
+			}
+		}
+
+		const double width = std::max(extent.getWidth(), std::numeric_limits<double>::min());
+		const double height = std::max(extent.getHeight(), std::numeric_limits<double>::min());
+
+		for(const auto& [x, y] : featureCenters){
+			const std::size_t cx = std::min<std::size_t>(GRID - 1, static_cast<std::size_t>((x - extent.getMinX()) / width * GRID));
+			const std::size_t cy = std::min<std::size_t>(GRID - 1, static_cast<std::size_t>((y - extent.getMinY()) / height * GRID));
+			prefix[(cy + 1) * (GRID + 1) + cx + 1] += 1;
+		}
+		for(std::size_t row = 1; row <= GRID; row++){
+			for(std::size_t col = 1; col <= GRID; col++){
+				prefix[row * (GRID + 1) + col] += prefix[(row - 1) * (GRID + 1) + col] + prefix[row * (GRID + 1) + col - 1] - prefix[(row - 1) * (GRID + 1) + col - 1];
+			}
+		}
+
+		// hotspots sit on features, so they follow the data; rank r is picked
+		// with weight 1 / r^s
+		if(spec.distribution == QueryDistribution::zipf && !featureCenters.empty()){
+
+			std::uniform_int_distribution<std::size_t> feature(0, featureCenters.size() - 1);
+			std::vector<double> weights;
+
+			for(std::size_t rank = 1; rank <= std::max<std::size_t>(spec.hotspots, 1); rank++){
+				hotspotCenters.push_back(featureCenters[feature(engine)]);
+				weights.push_back(1.0 / std::pow(static_cast<double>(rank), spec.zipfExponent));
+			}
+			hotspotChoice = std::discrete_distribution<std::size_t>(weights.begin(), weights.end());
+		}
+	}
+
+	void WorkloadGenerator::center(double& x, double& y){
+
+		if(spec.distribution == QueryDistribution::data && !featureCenters.empty()){
+
+			std::uniform_int_distribution<std::size_t> feature(0, featureCenters.size() - 1);
+			std::tie(x, y) = featureCenters[feature(engine)];
+
+		}else if(spec.distribution == QueryDistribution::zipf && !hotspotCenters.empty()){
+
+			const auto& [hx, hy] = hotspotCenters[hotspotChoice(engine)];
+			std::normal_distribution<double> dx(hx, std::max(extent.getWidth() * spec.hotspotSpread, std::numeric_limits<double>::min()));
+			std::normal_distribution<double> dy(hy, std::max(extent.getHeight() * spec.hotspotSpread, std::numeric_limits<double>::min()));
+			x = std::clamp(dx(engine), extent.getMinX(), extent.getMaxX());
+			y = std::clamp(dy(engine), extent.getMinY(), extent.getMaxY());
+
+		}else{
+
+			std::uniform_real_distribution<double> ux(extent.getMinX(), extent.getMaxX());
+			std::uniform_real_distribution<double> uy(extent.getMinY(), extent.getMaxY());
+			x = ux(engine);
+			y = uy(engine);
+		}
+	}
+
+	// Count of feature centres in [minX, x] x [minY, y], taking the features
+	// of a grid cell as spread uniformly over it: a bilinear interpolation of
+	// the prefix sums.
+	double WorkloadGenerator::cumulative(double x, double y) const{
+
+		const double width = std::max(extent.getWidth(), std::numeric_limits<double>::min());
+		const double height = std::max(extent.getHeight(), std::numeric_limits<double>::min());
+
+		const double gx = std::clamp((x - extent.getMinX()) / width * GRID, 0.0, static_cast<double>(GRID));
+		const double gy = std::clamp((y - extent.getMinY()) / height * GRID, 0.0, static_cast<double>(GRID));
+
+		const std::size_t col = std::min<std::size_t>(GRID - 1, static_cast<std::size_t>(gx));
+		const std::size_t row = std::min<std::size_t>(GRID - 1, static_cast<std::size_t>(gy));
+		const double fx = gx - col;
+		const double fy = gy - row;
+
+		auto at = [this](const std::size_t r, const std::size_t c){
+			return prefix[r * (GRID + 1) + c];
+		};
+
+		return at(row, col) * (1 - fx) * (1 - fy) + at(row, col + 1) * fx * (1 - fy)
+			+ at(row + 1, col) * (1 - fx) * fy + at(row + 1, col + 1) * fx * fy;
+	}
+
+	double WorkloadGenerator::estimateCount(const geos::geom::Envelope& box) const{
+		return cumulative(box.getMaxX(), box.getMaxY()) - cumulative(box.getMinX(), box.getMaxY())
+			- cumulative(box.getMaxX(), box.getMinY()) + cumulative(box.getMinX(), box.getMinY());
+	}
+
+	// Half side of the square centred on (x, y) expected to hold that many
+	// features, found by bisection on the density grid.
+	double WorkloadGenerator::halfSideFor(const double x, const double y, const double features) const{
+
+		double low = 0;
+		double high = std::max({x - extent.getMinX(), extent.getMaxX() - x, y - extent.getMinY(), extent.getMaxY() - y});
+
+		for(int i = 0; i < 50; i++){
+			const double half = (low + high) / 2;
+			if(estimateCount(geos::geom::Envelope(x - half, x + half, y - half, y + half)) < features){
+				low = half;
+			}else{
+				high = half;
+			}
+		}
+		return high;
+	}
+
+	Query WorkloadGenerator::next(){
+
+		Query query;
+		query.kind = static_cast<QueryKind>(kindChoice(engine));
+
+		// fixed-size boxes are kept inside the extent, as the interactive
+		// commands always did
+		if(query.kind == QueryKind::box && spec.selectivity <= 0 && !spec.sizes.empty()){
+
+			std::uniform_int_distribution<std::size_t> size(0, spec.sizes.size() - 1);
+			const auto [width, height] = spec.sizes[size(engine)];
+
+			std::uniform_real_distribution<double> ux(extent.getMinX(), std::max(extent.getMinX(), extent.getMaxX() - width));
+			std::uniform_real_distribution<double> uy(extent.getMinY(), std::max(extent.getMinY(), extent.getMaxY() - height));
+			const double x1 = ux(engine);
+			const double y1 = uy(engine);
+
+			query.box = geos::geom::Envelope(x1, x1 + width, y1, y1 + height);
+			query.x = x1 + width / 2;
+			query.y = y1 + height / 2;
+			return query;
+		}
+
+		center(query.x, query.y);
+
+		const double target = std::max(spec.selectivity, 0.0) * featureCenters.size();
+
+		switch(query.kind){
+		case QueryKind::point:
+			query.box = geos::geom::Envelope(query.x, query.x, query.y, query.y);
+			break;
+		case QueryKind::box:{
+			const double half = halfSideFor(query.x, query.y, target);
+			query.box = geos::geom::Envelope(query.x - half, query.x + half, query.y - half, query.y + half);
+			break;
+		}
+		case QueryKind::radius:
+			// the circle with the area of the square, or of a fixed-size box
+			if(spec.selectivity <= 0 && !spec.sizes.empty()){
+				std::uniform_int_distribution<std::size_t> size(0, spec.sizes.size() - 1);
+				const auto [width, height] = spec.sizes[size(engine)];
+				query.radius = std::sqrt(width * height / std::numbers::pi);
+			}else{
+				query.radius = halfSideFor(query.x, query.y, target) * 2 / std::sqrt(std::numbers::pi);
+			}
+			query.box = geos::geom::Envelope(query.x - query.radius, query.x + query.radius, query.y - query.radius, query.y + query.radius);
+			break;
+		case QueryKind::knn:
+			query.k = spec.k;
+			query.box = geos::geom::Envelope(query.x, query.x, query.y, query.y);
+			break;
+		}
+
+		return query;
+	}
+
+	std::vector<Query> WorkloadGenerator::generate(const std::size_t count){
+
+		std::vector<Query> queries;
+		queries.reserve(count);
+		for(std::size_t i = 0; i < count; i++){
+			queries.push_back(next());
+		}
+		return queries;
+	}
+
+	void saveWorkload(std::ostream& out, const WorkloadSpec& spec, const std::vector<Query>& queries){
+
+		out<<"# workload "<<describe(spec)<<"\n"<<std::setprecision(17);
+
+		for(const Query& query : queries){
+
+			out<<queryKindName(query.kind);
+			switch(query.kind){
+			case QueryKind::box:
+				out<<" "<<query.box.getMinX()<<" "<<query.box.getMinY()<<" "<<query.box.getMaxX()<<" "<<query.box.getMaxY();
+				break;
+			case QueryKind::point:
+				out<<" "<<query.x<<" "<<query.y;
+				break;
+			case QueryKind::radius:
+				out<<" "<<query.x<<" "<<query.y<<" "<<query.radius;
+				break;
+			case QueryKind::knn:
+				out<<" "<<query.x<<" "<<query.y<<" "<<query.k;
+				break;
+			}
+			out<<"\n";
+		}
+	}
+
+	bool loadWorkload(std::istream& in, std::vector<Query>& queries, std::string& error){
+
+		queries.clear();
+
+		std::size_t lineNumber = 0;
+		for(std::string line; std::getline(in, line); ){
+
+			lineNumber++;
+			if(line.empty() || line[0] == '#'){
+				continue;
+			}
+
+			std::istringstream iss(line);
+			std::string kind;
+			Query query;
+			bool valid = false;
+
+			iss>>kind;
+			// the query is only made from a fully parsed line
+			double x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+			if(kind == "box"){
+				valid = static_cast<bool>(iss>>x1>>y1>>x2>>y2);
+				query.kind = QueryKind::box;
+			}else if(kind == "point"){
+				valid = static_cast<bool>(iss>>query.x>>query.y);
+				query.kind = QueryKind::point;
+			}else if(kind == "radius"){
+				valid = static_cast<bool>(iss>>query.x>>query.y>>query.radius);
+				query.kind = QueryKind::radius;
+			}else if(kind == "knn"){
+				valid = static_cast<bool>(iss>>query.x>>query.y>>query.k);
+				query.kind = QueryKind::knn;
+			}
+
+			if(!valid || !(iss>>std::ws).eof()){
+				error = "invalid query at line " + std::to_string(lineNumber);
+				return false;
+			}
+
+			switch(query.kind){
+			case QueryKind::box:
+				query.box = geos::geom::Envelope(x1, x2, y1, y2);
+				query.x = (x1 + x2) / 2;
+				query.y = (y1 + y2) / 2;
+				break;
+			case QueryKind::radius:
+				query.box = geos::geom::Envelope(query.x - query.radius, query.x + query.radius, query.y - query.radius, query.y + query.radius);
+				break;
+			case QueryKind::point:
+			case QueryKind::knn:
+				query.box = geos::geom::Envelope(query.x, query.x, query.y, query.y);
+				break;
+			}
+			queries.push_back(query);
+		}
+
+		return true;
+	}
+}